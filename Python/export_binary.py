@@ -0,0 +1,104 @@
+"""
+@file export_binary.py
+@brief Converts an RTNeural JSON export (see model.py) into the binary weight format the plugin
+       loads with a straight memcpy. The floats are written in exactly the order of LSTMWeights in
+       two_input/Source/LSTMWeights.h (GRUWeights in GRUWeights.h for a GRU export), so nothing is
+       parsed or reshuffled at plugin load.
+
+Usage: python export_binary.py model_export/ts_nine.json [more.json ...]
+       writes model_export/ts_nine.nsw next to each input
+"""
+
+import json
+import os
+import struct
+import sys
+
+#The magic names the cell type, see NswHeader in LSTMWeights.h
+MAGIC = {'lstm': b'NSW1', 'gru': b'NSG1'}
+VERSION = 1
+
+
+def units_per_block(hidden_size):
+    #must match LSTMWeights::unitsPerBlock and GRUWeights::unitsPerBlock
+    return 8 if hidden_size % 8 == 0 else hidden_size
+
+
+def blocked_order(hidden, num_gates):
+    """Keras column (gate * hidden + unit) for each blocked column, same as LSTMWeights::column"""
+    units = units_per_block(hidden)
+    order = [0] * (num_gates * hidden)
+    for gate in range(num_gates):
+        for unit in range(hidden):
+            order[(unit // units) * num_gates * units + gate * units + unit % units] = gate * hidden + unit
+    return order
+
+
+def lstm_arrays(kernel, recurrent, bias):
+    order = blocked_order(len(recurrent), 4)
+    inputs = [[row[src] for src in order] for row in kernel]
+    return inputs, order, [bias[src] for src in order]
+
+
+def gru_arrays(kernel, recurrent, bias):
+    """Gate rows as in GRUWeights: blocked z, r and the recurrent half of n, then the
+    input half of n (which the input kernel feeds instead of the blocked n column)"""
+    hidden = len(recurrent)
+    assert len(bias) == 2, 'expected a GRU trained with reset_after=True'
+    input_bias, recurrent_bias = bias
+
+    order = blocked_order(hidden, 3)
+    candidate = [2 * hidden + unit for unit in range(hidden)]
+    is_candidate = lambda src: src >= 2 * hidden
+
+    inputs = [[0.0 if is_candidate(src) else row[src] for src in order] + [row[src] for src in candidate] for row in kernel]
+    #summed as floats, like GRUWeights::loadJson, so both loads give the same bits
+    f32 = lambda v: struct.unpack('<f', struct.pack('<f', v))[0]
+    gate_bias = [recurrent_bias[src] if is_candidate(src) else f32(input_bias[src]) + f32(recurrent_bias[src]) for src in order]
+    return inputs, order, gate_bias + [input_bias[src] for src in candidate]
+
+
+def convert(json_path, out_path=None):
+    with open(json_path) as f:
+        model = json.load(f)
+
+    rnn, dense = model['layers']
+    cell = rnn['type']
+    assert cell in MAGIC and dense['type'] == 'dense', 'expected LSTM or GRU -> Dense'
+
+    kernel, recurrent, bias = rnn['weights']
+    dense_kernel, dense_bias = dense['weights']
+
+    in_size = len(kernel)
+    hidden = len(recurrent)
+    units = units_per_block(hidden)
+    num_blocks = hidden // units
+
+    inputs, order, gate_bias = (gru_arrays if cell == 'gru' else lstm_arrays)(kernel, recurrent, bias)
+    gates_per_block = len(order) // num_blocks
+
+    floats = []
+    for row in inputs:
+        floats += row
+
+    for b in range(num_blocks):
+        for k in range(hidden):
+            floats += [recurrent[k][src] for src in order[b * gates_per_block:(b + 1) * gates_per_block]]
+
+    floats += gate_bias
+    floats += [dense_kernel[k][0] for k in range(hidden)]
+    floats += [dense_bias[0]]
+
+    out_path = out_path or os.path.splitext(json_path)[0] + '.nsw'
+    with open(out_path, 'wb') as f:
+        f.write(MAGIC[cell])
+        f.write(struct.pack('<4I', VERSION, in_size, hidden, units))
+        f.write(struct.pack(f'<{len(floats)}f', *floats))
+
+    print(f"Wrote {out_path} ({cell.upper()} {in_size}->{hidden}, {len(floats)} floats)")
+    return out_path
+
+
+if __name__ == '__main__':
+    for path in sys.argv[1:]:
+        convert(path)
@@ -10,17 +10,28 @@
 
 
 
+import argparse
 import numpy as np
 import tensorflow as tf
 from tensorflow.keras import layers, optimizers
 from tqdm.auto import tqdm
 from RTNeural.python.model_utils import save_model
+from export_binary import convert as export_binary
 import matplotlib.pyplot as plt
 from sklearn.model_selection import train_test_split
 from sklearn.utils import shuffle
 
 DATA_PATH = './audio/postproc/test-dataset.npz'
 
+#Hidden sizes the plugin's quality parameter picks between (ModelFamily in PluginProcessor.h).
+#FULL_SIZE keeps the plain export name, the others are exported as <name>_h<size>.json
+HIDDEN_SIZES = [16, 24, 32, 48, 64]
+FULL_SIZE = 64
+
+def export_path(name, hidden_size):
+    suffix = '' if hidden_size == FULL_SIZE else f'_h{hidden_size}'
+    return f'./model_export/{name}{suffix}.json'
+
 # --------------------------------------------------
 # Data Loading (ensure shape (N, T, 1))
 # --------------------------------------------------
@@ -79,11 +90,17 @@ def combined_loss(y_true, y_pred):
 # --------------------------------------------------
 # Build Stateful Model
 # --------------------------------------------------
-def build_model(batch_size):
+def recurrent_layer(cell, hidden_size, stateful):
+    #reset_after (the default) is the GRU variant GRUWeights.h expects
+    if cell == 'gru':
+        return layers.GRU(hidden_size, return_sequences=True, stateful=stateful, reset_after=True, name='stateful_rnn')
+    return layers.LSTM(hidden_size, return_sequences=True, stateful=stateful, name='stateful_rnn')
+
+def build_model(batch_size, hidden_size=FULL_SIZE, cell='lstm'):
     tf.keras.backend.clear_session()
     m = tf.keras.Sequential([
         layers.Input(batch_shape=(batch_size, None, 2)), #two inputs used
-        layers.LSTM(64, return_sequences=True, stateful=True, name='stateful_lstm'),
+        recurrent_layer(cell, hidden_size, stateful=True),
         layers.Dense(1, activation=None),
     ])
     return m
@@ -91,11 +108,11 @@ def build_model(batch_size):
 # --------------------------------------------------
 # Build Stateless Inference Engine for Validation
 # --------------------------------------------------
-def build_inference_model():
+def build_inference_model(hidden_size=FULL_SIZE, cell='lstm'):
     tf.keras.backend.clear_session()
     m = tf.keras.Sequential([
         layers.Input(shape=(None,2)), #two inputs used
-        layers.LSTM(64, return_sequences=True, stateful=False, name='stateful_lstm'),
+        recurrent_layer(cell, hidden_size, stateful=False),
         layers.Dense(1, activation=None),
     ])
     return m
@@ -118,7 +135,7 @@ def train_model(model, in_batches, out_batches, in_val, out_val, optimizer, epoc
 
         for xb, yb in zip(in_batches, out_batches): #cycles through the batches until the entire dataset is processed
             # print(f"shape of xb in train : {xb.shape}")
-            model.get_layer('stateful_lstm').reset_states() #reset between each batch
+            model.get_layer('stateful_rnn').reset_states() #reset between each batch
             model(xb[:, :warmup_len, :]) #warm up before each batch
 
             #calculate loss per sequence
@@ -134,7 +151,7 @@ def train_model(model, in_batches, out_batches, in_val, out_val, optimizer, epoc
         if ep % 2 == 0:
             # print(f"Shape of validation dataset per epoch: {in_val.shape}")
     
-            inf.get_layer('stateful_lstm').reset_states()
+            inf.get_layer('stateful_rnn').reset_states()
             inf.set_weights(model.get_weights())
             y_pred_val = inf.predict(in_val, batch_size=32)
             # print("VAL PREDICTED")
@@ -193,6 +210,14 @@ def check_waveform(model, X, y, label):
 # Main
 # --------------------------------------------------
 if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--name', default='ts_nine', help='export name, e.g. ts_nine or ts_mini')
+    parser.add_argument('--hidden', type=int, nargs='+', default=[FULL_SIZE], choices=HIDDEN_SIZES,
+                        help='hidden sizes to train, one model each (e.g. --hidden 16 24 32 48 64)')
+    parser.add_argument('--cell', default='lstm', choices=['lstm', 'gru'],
+                        help='recurrent layer; the plugin picks its network from the export, so a gru export just replaces the lstm one')
+    args = parser.parse_args()
+
     # Load & split
     X_train, y_train, X_val, y_val = prepare_dataset()
 
@@ -216,28 +241,34 @@ if __name__ == '__main__':
     OUT_val = y_val # .reshape((y_val.shape[0], NUM_SAMPLES, 1))
 
 
-    # Build model and optimizer
-    model = build_model(batch_size=BATCH_SIZE)
-    inf = build_inference_model()
-    optimizer = optimizers.Adam(5e-4)
+    for hidden_size in args.hidden:
+        print(f"\nTraining {args.name} ({args.cell.upper()}) with {hidden_size} hidden units")
 
-    # Train
-    train_hist, val_hist = train_model(model, in_batches, out_batches, IN_val, OUT_val, optimizer, epochs, warmup_len, segment_len, inf)
+        # Build model and optimizer
+        model = build_model(batch_size=BATCH_SIZE, hidden_size=hidden_size, cell=args.cell)
+        inf = build_inference_model(hidden_size, args.cell)
+        optimizer = optimizers.Adam(5e-4)
 
-    # Save model
-    save_model(model, './model_export/ts_nine.json')
+        # Train
+        train_hist, val_hist = train_model(model, in_batches, out_batches, IN_val, OUT_val, optimizer, epochs, warmup_len, segment_len, inf)
 
+        # Save model
+        json_path = export_path(args.name, hidden_size)
+        save_model(model, json_path)
+        export_binary(json_path) #precompiled weights the plugin loads without parsing
 
-    # Plot training history
-    plt.plot(train_hist, label='Train Loss')
-    plt.plot(list(range(0, epochs, 2)), val_hist, label='Val Loss')
-    plt.xlabel('Epoch')
-    plt.ylabel('Loss')
-    plt.legend()
-    plt.grid(True)
-    plt.show()
 
-    # Inference waveform checks
-    infer = build_inference_model()
-    infer.set_weights(model.get_weights())
-    check_waveform(infer, X_val,   y_val,   "Validation Waveforms")
\ No newline at end of file
+        # Plot training history
+        plt.plot(train_hist, label='Train Loss')
+        plt.plot(list(range(0, epochs, 2)), val_hist, label='Val Loss')
+        plt.xlabel('Epoch')
+        plt.ylabel('Loss')
+        plt.title(f'{args.name}, {hidden_size} hidden units')
+        plt.legend()
+        plt.grid(True)
+        plt.show()
+
+        # Inference waveform checks
+        infer = build_inference_model(hidden_size, args.cell)
+        infer.set_weights(model.get_weights())
+        check_waveform(infer, X_val,   y_val,   "Validation Waveforms")
\ No newline at end of file
@@ -0,0 +1,407 @@
+/*
+  ==============================================================================
+
+    Accuracy.cpp
+    Renders the TS9 captures in audio/preproc through processBlock with every
+    available kernel, weight precision and activation accuracy and checks the error against the
+    targets with the same ESR and DC losses model.py trains with. The original RTNeural
+    model renders them too, which the portable kernel is held to.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/** One input/target pair, prepared the way Python/preprocessing.py prepares it:
+    mono, trimmed to the shorter file, normalised by their common peak.
+*/
+struct Capture
+{
+    juce::String name;
+    float drive {0.0f};
+    double sampleRate {0.0};
+    juce::AudioBuffer<float> input, target;
+};
+
+struct AccuracyResult
+{
+    juce::String capture, kernel, precision, activations;
+    double esr {0.0}, dc {0.0};
+    double nsPerSample {0.0}, realtimeFactor {0.0};
+
+    /** The training loss, see combined_loss in model.py. */
+    double loss() const { return esr + dc; }
+};
+
+
+//==============================================================================
+static juce::AudioBuffer<float> readMono (juce::AudioFormatReader& reader, int numSamples)
+{
+    juce::AudioBuffer<float> file ((int) reader.numChannels, numSamples);
+    reader.read (&file, 0, numSamples, 0, true, true);
+
+    //average the channels like librosa's mono=True
+    juce::AudioBuffer<float> mono (1, numSamples);
+    mono.clear();
+    for (int ch = 0; ch < file.getNumChannels(); ++ch)
+        mono.addFrom (0, 0, file, ch, 0, numSamples, 1.0f / (float) file.getNumChannels());
+
+    return mono;
+}
+
+/** TS9_-<drive>-input.wav next to TS9_-<drive>-target.wav, at most maxSeconds long. */
+static bool loadCapture (juce::AudioFormatManager& formats, const juce::File& inputFile, double maxSeconds, Capture& capture)
+{
+    const auto targetFile = inputFile.getSiblingFile (inputFile.getFileName().replace ("-input.wav", "-target.wav"));
+
+    std::unique_ptr<juce::AudioFormatReader> in (formats.createReaderFor (inputFile));
+    std::unique_ptr<juce::AudioFormatReader> out (formats.createReaderFor (targetFile));
+    if (in == nullptr || out == nullptr)
+        return false;
+
+    if (in->sampleRate != out->sampleRate)
+        return false;
+
+    const auto length = (int) juce::jmin (in->lengthInSamples, out->lengthInSamples, (juce::int64) (maxSeconds * in->sampleRate));
+
+    capture.name = inputFile.getFileName().upToLastOccurrenceOf ("-input", false, false);
+    capture.drive = inputFile.getFileName().fromFirstOccurrenceOf ("-", false, false).upToFirstOccurrenceOf ("-", false, false).getFloatValue();
+    capture.sampleRate = in->sampleRate;
+    capture.input = readMono (*in, length);
+    capture.target = readMono (*out, length);
+
+    const auto peak = juce::jmax (capture.input.getMagnitude (0, 0, length), capture.target.getMagnitude (0, 0, length));
+    if (peak <= 0.0f)
+        return false;
+
+    capture.input.applyGain (1.0f / peak);
+    capture.target.applyGain (1.0f / peak);
+    return true;
+}
+
+
+//==============================================================================
+/** ESR with the first order pre-emphasis from model.py (y[n] - 0.85 y[n-1], first sample kept). */
+static double esrLoss (const float* target, const float* predicted, int numSamples, double coeff = 0.85)
+{
+    double error = 0.0, energy = 0.0;
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        const auto t = target[n]    - (n > 0 ? coeff * target[n - 1]    : 0.0);
+        const auto p = predicted[n] - (n > 0 ? coeff * predicted[n - 1] : 0.0);
+        error  += (t - p) * (t - p);
+        energy += t * t;
+    }
+
+    return energy > 0.0 ? error / energy : 0.0;
+}
+
+/** Squared difference of the means over the target's mean power, like dc_loss. */
+static double dcLoss (const float* target, const float* predicted, int numSamples)
+{
+    double targetMean = 0.0, predictedMean = 0.0, power = 0.0;
+
+    for (int n = 0; n < numSamples; ++n)
+    {
+        targetMean += target[n];
+        predictedMean += predicted[n];
+        power += (double) target[n] * target[n];
+    }
+
+    targetMean /= numSamples;
+    predictedMean /= numSamples;
+    power /= numSamples;
+
+    return power > 0.0 ? (targetMean - predictedMean) * (targetMean - predictedMean) / power : 0.0;
+}
+
+
+static const char* getPrecisionName (WeightPrecision precision)
+{
+    switch (precision)
+    {
+        case WeightPrecision::half: return "fp16";
+        case WeightPrecision::int8: return "int8";
+        case WeightPrecision::full: break;
+    }
+
+    return "fp32";
+}
+
+
+//==============================================================================
+/** Renders a capture through a fresh processor at unity level with the tone knob open. */
+static AccuracyResult render (const Capture& capture, const LSTMKernel::Kernel& kernel, WeightPrecision precision,
+                              ActivationAccuracy activations, int blockSize)
+{
+    Two_inputAudioProcessor processor;
+    processor.setKernel (kernel);
+    processor.setWeightPrecision (precision);
+    processor.setActivationAccuracy (activations);
+    processor.setNonRealtime (true); //keeps the quality governor out of it
+
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add  (juce::AudioChannelSet::mono());
+    layout.outputBuses.add (juce::AudioChannelSet::mono());
+    processor.setBusesLayout (layout);
+
+    auto setParam = [&processor] (const char* id, float value)
+    {
+        auto* param = processor.apvts.getParameter (id);
+        param->setValueNotifyingHost (param->convertTo0to1 (value));
+    };
+
+    setParam ("DRIVE", capture.drive);
+    setParam ("VOLUME", 1.0f / 0.9f); //processBlock scales the level knob by 0.9
+    setParam ("TONE", 20000.0f);
+    setParam ("TS9", 1.0f);
+    setParam ("MINI", 0.0f);
+
+    processor.setRateAndBufferSizeDetails (capture.sampleRate, blockSize);
+    processor.prepareToPlay (capture.sampleRate, blockSize);
+
+    //the processor's latency (the resampler's, at rates other than 44.1k) is taken out by
+    //running that much silence past the end and dropping the first that many samples
+    const auto length = capture.input.getNumSamples();
+    const auto latency = processor.getLatencySamples();
+    juce::AudioBuffer<float> output (1, length), block (1, blockSize);
+
+    juce::MidiBuffer midi;
+    juce::int64 ticks = 0;
+
+    for (int pos = 0; pos < length + latency; pos += blockSize)
+    {
+        const auto n = juce::jmin (blockSize, length + latency - pos);
+        block.setSize (1, n, false, false, true);
+        block.clear();
+        block.copyFrom (0, 0, capture.input, 0, pos, juce::jlimit (0, n, length - pos));
+
+        const auto t0 = juce::Time::getHighResolutionTicks();
+        processor.processBlock (block, midi);
+        ticks += juce::Time::getHighResolutionTicks() - t0;
+
+        const auto first = juce::jmax (0, latency - pos);
+        if (first < n)
+            output.copyFrom (0, pos + first - latency, block, 0, first, n - first);
+    }
+
+    processor.releaseResources();
+
+    AccuracyResult result;
+    result.capture = capture.name;
+    result.kernel = kernel.name;
+    result.precision = getPrecisionName (precision);
+    result.activations = getActivationAccuracyName (activations);
+    result.esr = esrLoss (capture.target.getReadPointer (0), output.getReadPointer (0), length);
+    result.dc = dcLoss (capture.target.getReadPointer (0), output.getReadPointer (0), length);
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds (ticks);
+    result.nsPerSample = seconds * 1.0e9 / length;
+    result.realtimeFactor = seconds > 0.0 ? length / capture.sampleRate / seconds : 0.0;
+    return result;
+}
+
+
+/** The capture through the RTNeural model the plugin shipped with, one sample at a time,
+    then through the same level and tone stage render() leaves open. Every other path is
+    only compared with the portable kernel, so this is what ties that to the trained model:
+    a layout, bias fold or Dense mistake that all of the engine's paths share shows up here.
+    There's no resampler in front of it, so it only stands in for processBlock at modelSampleRate.
+*/
+static AccuracyResult renderRTNeural (const Capture& capture)
+{
+    RTNeural::ModelT<float, 2, 1,
+                    RTNeural::LSTMLayerT<float, 2, 64>,
+                    RTNeural::DenseT<float, 64, 1>> net;
+    net.parseJson (nlohmann::json::parse (BinaryData::ts_nine_json, BinaryData::ts_nine_json + BinaryData::ts_nine_jsonSize));
+    net.reset();
+
+    OutputStage stage;
+    stage.prepare (capture.sampleRate, 1);
+    stage.setCutoff (20000.0f);
+    stage.setGain (1.0f, 0.0f);
+
+    const auto length = capture.input.getNumSamples();
+    juce::AudioBuffer<float> output (1, length);
+    const auto* x = capture.input.getReadPointer (0);
+    auto* y = output.getWritePointer (0);
+
+    const auto t0 = juce::Time::getHighResolutionTicks();
+
+    for (int n = 0; n < length; ++n)
+    {
+        const float input[] { x[n], capture.drive };
+        y[n] = net.forward (input);
+    }
+
+    stage.process (output.getArrayOfWritePointers(), stage.getSettings(), 0, 1, length);
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - t0);
+
+    AccuracyResult result;
+    result.capture = capture.name;
+    result.kernel = "rtneural";
+    result.precision = "fp32";
+    result.activations = "exact";
+    result.esr = esrLoss (capture.target.getReadPointer (0), y, length);
+    result.dc = dcLoss (capture.target.getReadPointer (0), y, length);
+    result.nsPerSample = seconds * 1.0e9 / length;
+    result.realtimeFactor = seconds > 0.0 ? length / capture.sampleRate / seconds : 0.0;
+    return result;
+}
+
+
+//==============================================================================
+static void printUsage()
+{
+    std::cout << "usage: NeuralScreamerAccuracy [options]\n"
+                 "  --audio=<dir>           folder with the TS9_-<drive>-input/-target.wav pairs (default audio/preproc)\n"
+                 "  --seconds=<n>           only use the first n seconds of each capture (default 30)\n"
+                 "  --block=<samples>       processBlock size (default 512)\n"
+                 "  --max-esr=<x>           fail if any capture's ESR is above x (default: no limit)\n"
+                 "  --rtneural-tolerance=<x> fail if the portable kernel's ESR is more than x from the RTNeural model's (default 0.0001)\n"
+                 "  --tolerance=<x>         fail if a kernel's ESR is more than x above the portable kernel's (default 0.001)\n"
+                 "  --quantized-tolerance=<x> the same for the fp16 and int8 weights (default 0.005)\n"
+                 "  --activation-tolerance=<x> the same for the accurate and fast activations (default 0.001)\n"
+                 "  --csv=<file>            also write the results as CSV\n";
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit; //APVTS needs a message manager
+
+    juce::ArgumentList args (argc, argv);
+    if (args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    auto option = [&args] (const juce::String& name, const juce::String& fallback)
+    {
+        auto value = args.getValueForOption (name);
+        return value.isEmpty() ? fallback : value;
+    };
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto audioDir = cwd.getChildFile (option ("--audio", "audio/preproc"));
+    const auto maxSeconds = juce::jmax (1.0, option ("--seconds", "30").getDoubleValue());
+    const auto blockSize = juce::jmax (1, option ("--block", "512").getIntValue());
+    const auto maxEsr = option ("--max-esr", "0").getDoubleValue();
+    const auto rtneuralTolerance = option ("--rtneural-tolerance", "0.0001").getDoubleValue();
+    const auto tolerance = option ("--tolerance", "0.001").getDoubleValue();
+    const auto quantizedTolerance = option ("--quantized-tolerance", "0.005").getDoubleValue();
+    const auto activationTolerance = option ("--activation-tolerance", "0.001").getDoubleValue();
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    auto inputs = audioDir.findChildFiles (juce::File::findFiles, false, "TS9_-*-input.wav");
+    inputs.sort();
+
+    if (inputs.isEmpty())
+    {
+        std::cerr << "no captures found in " << audioDir.getFullPathName() << " (they are stored with git lfs)\n";
+        return 1;
+    }
+
+    //the portable kernel at fp32 with exact activations is the reference every faster path
+    //is held to, and it is held to the RTNeural model. Every kernel runs at fp32, the reduced
+    //precisions and the approximate activations only run on the one the plugin picks
+    const auto kernels = LSTMKernel::getAvailable();
+    const auto* reference = kernels.getLast();
+
+    struct Run { const LSTMKernel::Kernel* kernel; WeightPrecision precision; ActivationAccuracy activations; };
+    juce::Array<Run> runs;
+
+    for (auto* kernel : kernels)
+        runs.add ({ kernel, WeightPrecision::full, ActivationAccuracy::exact });
+
+    runs.add ({ &LSTMKernel::select(), WeightPrecision::half, ActivationAccuracy::exact });
+    runs.add ({ &LSTMKernel::select(), WeightPrecision::int8, ActivationAccuracy::exact });
+    runs.add ({ &LSTMKernel::select(), WeightPrecision::full, ActivationAccuracy::accurate });
+    runs.add ({ &LSTMKernel::select(), WeightPrecision::full, ActivationAccuracy::fast });
+
+    juce::Array<AccuracyResult> results;
+    int failures = 0;
+
+    std::cout << "capture            kernel     weights activations ESR        DC         loss       ns/sample  realtime\n";
+
+    auto print = [] (const AccuracyResult& r, const juce::String& verdict)
+    {
+        std::cout << r.capture.paddedRight (' ', 19) << r.kernel.paddedRight (' ', 11) << r.precision.paddedRight (' ', 8)
+                  << r.activations.paddedRight (' ', 12)
+                  << juce::String (r.esr, 6).paddedRight (' ', 11) << juce::String (r.dc, 6).paddedRight (' ', 11)
+                  << juce::String (r.loss(), 6).paddedRight (' ', 11) << juce::String (r.nsPerSample, 1).paddedRight (' ', 11)
+                  << juce::String (r.realtimeFactor, 1) << "x" << verdict << "\n";
+    };
+
+    for (auto& file : inputs)
+    {
+        Capture capture;
+        if (! loadCapture (formats, file, maxSeconds, capture))
+        {
+            std::cerr << file.getFileName() << ": could not load the capture or its target\n";
+            ++failures;
+            continue;
+        }
+
+        //reference first so the others can be compared against it
+        auto referenceResult = render (capture, *reference, WeightPrecision::full, ActivationAccuracy::exact, blockSize);
+
+        if (capture.sampleRate == Two_inputAudioProcessor::modelSampleRate)
+        {
+            const auto r = renderRTNeural (capture);
+
+            juce::String verdict;
+            if (std::abs (referenceResult.esr - r.esr) > rtneuralTolerance)
+                verdict = "  FAIL (" + juce::String (reference->name) + " is " + juce::String (referenceResult.esr - r.esr, 6) + " from this)";
+
+            failures += verdict.isNotEmpty() ? 1 : 0;
+            print (r, verdict);
+            results.add (r);
+        }
+        else
+        {
+            std::cout << capture.name.paddedRight (' ', 19) << "rtneural   skipped, the capture isn't at "
+                      << Two_inputAudioProcessor::modelSampleRate << " Hz\n";
+        }
+
+        for (auto& run : runs)
+        {
+            const auto isReference = run.kernel == reference && run.precision == WeightPrecision::full
+                                      && run.activations == ActivationAccuracy::exact;
+            const auto r = isReference ? referenceResult : render (capture, *run.kernel, run.precision, run.activations, blockSize);
+            const auto allowed = run.precision != WeightPrecision::full ? quantizedTolerance
+                               : run.activations != ActivationAccuracy::exact ? activationTolerance
+                               : tolerance;
+
+            juce::String verdict;
+            if (maxEsr > 0.0 && r.esr > maxEsr)
+                verdict = "  FAIL (ESR above " + juce::String (maxEsr) + ")";
+            else if (r.esr - referenceResult.esr > allowed)
+                verdict = "  FAIL (" + juce::String (r.esr - referenceResult.esr, 6) + " worse than " + reference->name + ")";
+
+            failures += verdict.isNotEmpty() ? 1 : 0;
+            print (r, verdict);
+            results.add (r);
+        }
+    }
+
+    const auto csvPath = args.getValueForOption ("--csv");
+    if (csvPath.isNotEmpty())
+    {
+        juce::String csv ("capture,kernel,precision,activations,esr,dc,loss,ns_per_sample,realtime_factor\n");
+        for (auto& r : results)
+            csv << r.capture << "," << r.kernel << "," << r.precision << "," << r.activations << "," << juce::String (r.esr, 8) << "," << juce::String (r.dc, 8) << ","
+                << juce::String (r.loss(), 8) << "," << juce::String (r.nsPerSample, 2) << "," << juce::String (r.realtimeFactor, 2) << "\n";
+
+        cwd.getChildFile (csvPath).replaceWithText (csv);
+    }
+
+    std::cout << (failures == 0 ? "\nall within tolerance\n" : "\n" + juce::String (failures) + " failure(s)\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,451 @@
+/*
+  ==============================================================================
+
+    Benchmarks.cpp
+    Throughput of the DSP chain: single LSTM steps up to full processBlock
+    calls, written out as CSV / JSON so runs can be compared.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/** One measured configuration. Fields that don't apply to a benchmark are left at 0 / empty. */
+struct BenchResult
+{
+    juce::String benchmark, model, kernel;
+    int channels {0};
+    double sampleRate {0.0};
+    int blockSize {0};
+    double nsPerSample {0.0};     //wall time per sample frame, all channels together
+
+    /** Seconds of audio rendered per second of wall time. */
+    double realtimeFactor() const { return nsPerSample > 0.0 && sampleRate > 0.0 ? 1.0e9 / (nsPerSample * sampleRate) : 0.0; }
+
+    /** Instances one core could run at 100% load. Leave headroom when sizing real machines. */
+    double instancesPerCore() const { return realtimeFactor(); }
+};
+
+struct BenchSettings
+{
+    double secondsPerRun {0.25}; //audio rendered per timed run
+    int runs {3};                //best of
+    bool quick {false};
+};
+
+
+//==============================================================================
+/** Calls process(), which handles framesPerCall frames, until secondsPerRun of audio
+    has gone through. Does that settings.runs times and returns the fastest run in ns per frame.
+*/
+template <typename ProcessFunction>
+static double timeNsPerFrame (const BenchSettings& settings, double sampleRate, int framesPerCall, ProcessFunction&& process)
+{
+    const auto calls = juce::jmax (1, (int) (settings.secondsPerRun * sampleRate) / framesPerCall);
+
+    //warm up caches, branch predictors and lazily loaded weights
+    for (int i = 0; i < juce::jmin (calls, 64); ++i)
+        process();
+
+    auto best = std::numeric_limits<double>::max();
+
+    for (int run = 0; run < settings.runs; ++run)
+    {
+        const auto t0 = juce::Time::getHighResolutionTicks();
+        for (int i = 0; i < calls; ++i)
+            process();
+        const auto t1 = juce::Time::getHighResolutionTicks();
+
+        best = juce::jmin (best, juce::Time::highResolutionTicksToSeconds (t1 - t0) * 1.0e9 / ((double) calls * framesPerCall));
+    }
+
+    return best;
+}
+
+static void fillWithGuitar (juce::AudioBuffer<float>& buffer, double sampleRate)
+{
+    //a decaying pluck with some overtones, so the network sees realistic levels
+    juce::Random random (1234);
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int n = 0; n < buffer.getNumSamples(); ++n)
+        {
+            const auto t = n / sampleRate;
+            const auto env = std::exp (-3.0 * t);
+            buffer.setSample (ch, n, (float) (env * (0.5 * std::sin (2.0 * juce::MathConstants<double>::pi * 110.0 * t)
+                                                    + 0.2 * std::sin (2.0 * juce::MathConstants<double>::pi * 330.0 * t)))
+                                     + 0.01f * (random.nextFloat() - 0.5f));
+        }
+}
+
+
+//==============================================================================
+/** The original per-sample RTNeural model the plugin shipped with, as a baseline. */
+static BenchResult benchRTNeuralModel (const BenchSettings& settings, const char* model, const char* data, int size)
+{
+    RTNeural::ModelT<float, 2, 1,
+                    RTNeural::LSTMLayerT<float, 2, 64>,
+                    RTNeural::DenseT<float, 64, 1>> net;
+    net.parseJson (nlohmann::json::parse (data, data + size));
+    net.reset();
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int frames = 256;
+    juce::AudioBuffer<float> source (1, frames), output (1, frames);
+    fillWithGuitar (source, sampleRate);
+
+    const auto ns = timeNsPerFrame (settings, sampleRate, frames, [&]
+    {
+        const auto* x = source.getReadPointer (0);
+        auto* y = output.getWritePointer (0);
+
+        for (int n = 0; n < frames; ++n)
+        {
+            const float input[] { x[n], 0.5f };
+            y[n] = net.forward (input);
+        }
+    });
+
+    return { "rtneural_lstm_forward", model, "rtneural", 1, sampleRate, 1, ns };
+}
+
+/** One BatchedRNN step for a stereo pair, per kernel this CPU supports, weight precision and
+    activation accuracy.
+*/
+static void benchLSTMStep (const BenchSettings& settings, juce::Array<BenchResult>& results)
+{
+    using Model = NeuralModel<LSTMWeights<2, 64>>;
+    Model::Weights weights;
+    loadModelWeights (weights, "ts_nine_nsw", "ts_nine_json");
+
+    Model::Quantized quantized;
+    quantized.quantize (weights);
+
+    const std::pair<WeightPrecision, const char*> precisions[] { { WeightPrecision::full, "" },
+                                                                 { WeightPrecision::half, "/fp16" },
+                                                                 { WeightPrecision::int8, "/int8" } };
+
+    const ActivationAccuracy accuracies[] { ActivationAccuracy::exact, ActivationAccuracy::accurate, ActivationAccuracy::fast };
+
+    for (auto* kernel : LSTMKernel::getAvailable())
+    {
+        for (auto& [precision, suffix] : precisions)
+        {
+            for (auto accuracy : accuracies)
+            {
+                Model::Batch lstm;
+                lstm.setWeights (&weights);
+                lstm.setQuantizedWeights (&quantized, precision);
+                lstm.setKernel (*kernel);
+                lstm.setActivationAccuracy (accuracy);
+                lstm.reset();
+
+                constexpr double sampleRate = 48000.0;
+                constexpr int frames = 256;
+                juce::AudioBuffer<float> source (2, frames), output (2, frames);
+                fillWithGuitar (source, sampleRate);
+
+                const auto ns = timeNsPerFrame (settings, sampleRate, frames, [&]
+                {
+                    for (int n = 0; n < frames; ++n)
+                    {
+                        const float input[2][2] { { source.getSample (0, n), 0.5f }, { source.getSample (1, n), 0.5f } };
+                        float y[2];
+                        lstm.forward (input, y);
+                        output.setSample (0, n, y[0]);
+                        output.setSample (1, n, y[1]);
+                    }
+                });
+
+                const juce::String activations (accuracy == ActivationAccuracy::exact ? "" : "/" + juce::String (getActivationAccuracyName (accuracy)));
+                results.add ({ "lstm_step", "ts9", juce::String (kernel->name) + suffix + activations, 2, sampleRate, 1, ns });
+            }
+        }
+    }
+}
+
+/** A stereo NeuralModel at one of the QUALITY sizes, LSTM or GRU. The cost doesn't depend
+    on what the weights are, so random ones stand in for models that haven't been trained yet.
+*/
+template <typename Weights>
+static BenchResult benchHiddenSize (const BenchSettings& settings)
+{
+    using Model = NeuralModel<Weights>;
+    constexpr int hiddenSize = Weights::numHidden;
+    auto weights = std::make_unique<typename Model::Weights>();
+
+    juce::Random random (hiddenSize);
+    auto randomise = [&random] (float* values, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            values[i] = 0.4f * (random.nextFloat() - 0.5f);
+    };
+
+    randomise (&weights->inputKernel[0][0], sizeof (weights->inputKernel) / sizeof (float));
+    randomise (&weights->recurrentKernel[0][0][0], sizeof (weights->recurrentKernel) / sizeof (float));
+    randomise (weights->bias, (size_t) Model::Weights::numGates);
+    randomise (weights->denseKernel, (size_t) hiddenSize);
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+
+    Model model;
+    model.setWeights (weights.get());
+    model.prepare (2, blockSize);
+
+    juce::AudioBuffer<float> source (2, blockSize), buffer (2, blockSize);
+    fillWithGuitar (source, sampleRate);
+
+    const auto ns = timeNsPerFrame (settings, sampleRate, blockSize, [&]
+    {
+        buffer.makeCopyOf (source, true);
+        model.process (buffer.getArrayOfWritePointers(), 2, blockSize, 0.5f);
+    });
+
+    const juce::String cell (Weights::cellType == CellType::gru ? "gru_" : "");
+    return { "hidden_size", cell + "h" + juce::String (hiddenSize), LSTMKernel::select().name, 2, sampleRate, blockSize, ns };
+}
+
+/** A stereo TS9 network over one block in sub-blocks of 32, the way processBlock hands it
+    over, with each channel on a thread of its own (WorkerPool) or both as a pair on this
+    one. Where the two cross is the block size minParallelSamples should sit at.
+*/
+static BenchResult benchWorkerPool (const BenchSettings& settings, bool pooled, int blockSize)
+{
+    using Model = NeuralModel<LSTMWeights<2, 64>>;
+    Model::Weights weights;
+    loadModelWeights (weights, "ts_nine_nsw", "ts_nine_json");
+
+    WorkerPool pool (1);
+    Model model;
+    model.setWeights (&weights);
+    model.setWorkerPool (&pool);
+    model.prepare (2, blockSize);
+
+    OutputStage stage;
+    stage.prepare (44100.0, 2);
+
+    juce::Array<SubBlockRun> runs;
+    for (int start = 0; start < blockSize; start += 32)
+        runs.add ({ start, juce::jmin (32, blockSize - start), 0.5f, stage.getSettings() });
+
+    constexpr double sampleRate = 44100.0;
+    juce::AudioBuffer<float> source (2, blockSize), buffer (2, blockSize);
+    fillWithGuitar (source, sampleRate);
+
+    const auto ns = timeNsPerFrame (settings, sampleRate, blockSize, [&]
+    {
+        buffer.makeCopyOf (source, true);
+        model.process (buffer.getArrayOfWritePointers(), 2, runs.getRawDataPointer(), runs.size(), &stage, pooled);
+    });
+
+    return { "worker_pool", "ts9", pooled ? "pooled" : "serial", 2, sampleRate, blockSize, ns };
+}
+
+/** Full processBlock of a fresh processor, the way a host would run it. */
+static BenchResult benchProcessBlock (const BenchSettings& settings, bool ts9, int channels, double sampleRate, int blockSize)
+{
+    Two_inputAudioProcessor processor;
+    processor.setAdaptiveQuality (false); //time the full size even when it overruns
+
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add  (juce::AudioChannelSet::canonicalChannelSet (channels));
+    layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (channels));
+    processor.setBusesLayout (layout);
+
+    auto setParam = [&processor] (const char* id, float value)
+    {
+        auto* param = processor.apvts.getParameter (id);
+        param->setValueNotifyingHost (param->convertTo0to1 (value));
+    };
+
+    setParam ("DRIVE", 0.7f);
+    setParam ("VOLUME", 1.0f);
+    setParam ("TONE", 8000.0f);
+    setParam ("TS9", ts9 ? 1.0f : 0.0f);
+    setParam ("MINI", ts9 ? 0.0f : 1.0f);
+
+    processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+    processor.prepareToPlay (sampleRate, blockSize);
+
+    juce::AudioBuffer<float> source (channels, blockSize), buffer (channels, blockSize);
+    fillWithGuitar (source, sampleRate);
+    juce::MidiBuffer midi;
+
+    const auto ns = timeNsPerFrame (settings, sampleRate, blockSize, [&]
+    {
+        buffer.makeCopyOf (source, true);
+        processor.processBlock (buffer, midi);
+    });
+
+    processor.releaseResources();
+    return { "process_block", ts9 ? "ts9" : "mini", processor.getActiveKernelName(), channels, sampleRate, blockSize, ns };
+}
+
+/** The level and tone stage as a pass of its own, the way it runs during a crossfade. */
+static BenchResult benchToneFilter (const BenchSettings& settings, int channels, double sampleRate, int blockSize)
+{
+    OutputStage stage;
+    stage.prepare (sampleRate, channels);
+    stage.setCutoff (8000.0f);
+    stage.setGain (0.9f, 0.0f);
+
+    juce::AudioBuffer<float> buffer (channels, blockSize);
+    fillWithGuitar (buffer, sampleRate);
+
+    const auto ns = timeNsPerFrame (settings, sampleRate, blockSize, [&]
+    {
+        stage.process (buffer.getArrayOfWritePointers(), stage.getSettings(), 0, channels, blockSize);
+    });
+
+    return { "tone_filter", {}, {}, channels, sampleRate, blockSize, ns };
+}
+
+
+//==============================================================================
+static juce::String toCsv (const juce::Array<BenchResult>& results)
+{
+    juce::String csv ("benchmark,model,kernel,channels,sample_rate,block_size,ns_per_sample,realtime_factor,instances_per_core\n");
+
+    for (auto& r : results)
+        csv << r.benchmark << "," << r.model << "," << r.kernel << "," << r.channels << ","
+            << juce::roundToInt (r.sampleRate) << "," << r.blockSize << "," << juce::String (r.nsPerSample, 2) << ","
+            << juce::String (r.realtimeFactor(), 2) << "," << juce::String (r.instancesPerCore(), 2) << "\n";
+
+    return csv;
+}
+
+static juce::String toJson (const juce::Array<BenchResult>& results)
+{
+    juce::Array<juce::var> list;
+
+    for (auto& r : results)
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty ("benchmark", r.benchmark);
+        entry->setProperty ("model", r.model);
+        entry->setProperty ("kernel", r.kernel);
+        entry->setProperty ("channels", r.channels);
+        entry->setProperty ("sample_rate", r.sampleRate);
+        entry->setProperty ("block_size", r.blockSize);
+        entry->setProperty ("ns_per_sample", r.nsPerSample);
+        entry->setProperty ("realtime_factor", r.realtimeFactor());
+        entry->setProperty ("instances_per_core", r.instancesPerCore());
+        list.add (juce::var (entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty ("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty ("default_kernel", LSTMKernel::select().name);
+    root->setProperty ("results", list);
+    return juce::JSON::toString (juce::var (root));
+}
+
+static void printUsage()
+{
+    std::cout << "usage: NeuralScreamerBench [options]\n"
+                 "  --quick          fewer block sizes and sample rates, shorter runs\n"
+                 "  --filter=<name>  only run benchmarks whose name contains <name>\n"
+                 "  --csv=<file>     write results as CSV (default: CSV to stdout)\n"
+                 "  --json=<file>    write results as JSON\n";
+}
+
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit; //APVTS needs a message manager
+
+    juce::ArgumentList args (argc, argv);
+    if (args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    BenchSettings settings;
+    settings.quick = args.containsOption ("--quick");
+    if (settings.quick)
+        settings.secondsPerRun = 0.05;
+
+    const auto filter = args.getValueForOption ("--filter");
+    auto wanted = [&filter] (const char* name) { return filter.isEmpty() || juce::String (name).contains (filter); };
+
+    const juce::Array<int> blockSizes = settings.quick ? juce::Array<int> { 64, 512, 4096 }
+                                                       : juce::Array<int> { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    const juce::Array<double> sampleRates = settings.quick ? juce::Array<double> { 48000.0 }
+                                                           : juce::Array<double> { 44100.0, 48000.0, 96000.0, 192000.0 };
+
+    std::cerr << "CPU: " << juce::SystemStats::getCpuModel() << ", default kernel: " << LSTMKernel::select().name << "\n";
+
+    juce::Array<BenchResult> results;
+    auto report = [&results] (const BenchResult& r)
+    {
+        std::cerr << r.benchmark << " " << r.model << " " << r.kernel << " ch=" << r.channels << " sr=" << r.sampleRate
+                  << " block=" << r.blockSize << ": " << juce::String (r.nsPerSample, 1) << " ns/sample\n";
+        results.add (r);
+    };
+
+    if (wanted ("rtneural_lstm_forward"))
+    {
+        report (benchRTNeuralModel (settings, "ts9", BinaryData::ts_nine_json, BinaryData::ts_nine_jsonSize));
+        report (benchRTNeuralModel (settings, "mini", BinaryData::ts_mini_json, BinaryData::ts_mini_jsonSize));
+    }
+
+    if (wanted ("lstm_step"))
+    {
+        juce::Array<BenchResult> steps;
+        benchLSTMStep (settings, steps);
+        for (auto& r : steps)
+            report (r);
+    }
+
+    if (wanted ("hidden_size"))
+    {
+        report (benchHiddenSize<LSTMWeights<2, 16>> (settings));
+        report (benchHiddenSize<LSTMWeights<2, 24>> (settings));
+        report (benchHiddenSize<LSTMWeights<2, 32>> (settings));
+        report (benchHiddenSize<LSTMWeights<2, 48>> (settings));
+        report (benchHiddenSize<LSTMWeights<2, 64>> (settings));
+
+        report (benchHiddenSize<GRUWeights<2, 16>> (settings));
+        report (benchHiddenSize<GRUWeights<2, 24>> (settings));
+        report (benchHiddenSize<GRUWeights<2, 32>> (settings));
+        report (benchHiddenSize<GRUWeights<2, 48>> (settings));
+        report (benchHiddenSize<GRUWeights<2, 64>> (settings));
+    }
+
+    if (wanted ("process_block"))
+        for (auto ts9 : { true, false })
+            for (auto channels : { 1, 2 })
+                for (auto sampleRate : sampleRates)
+                    for (auto blockSize : blockSizes)
+                        report (benchProcessBlock (settings, ts9, channels, sampleRate, blockSize));
+
+    if (wanted ("worker_pool"))
+        for (auto pooled : { false, true })
+            for (auto blockSize : { 16, 32, 64, 128, 256, 512, 1024 })
+                report (benchWorkerPool (settings, pooled, blockSize));
+
+    if (wanted ("tone_filter"))
+        for (auto channels : { 1, 2 })
+            for (auto blockSize : blockSizes)
+                report (benchToneFilter (settings, channels, 48000.0, blockSize));
+
+    //Results
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto csvPath = args.getValueForOption ("--csv");
+    const auto jsonPath = args.getValueForOption ("--json");
+
+    if (csvPath.isNotEmpty())
+        cwd.getChildFile (csvPath).replaceWithText (toCsv (results));
+
+    if (jsonPath.isNotEmpty())
+        cwd.getChildFile (jsonPath).replaceWithText (toJson (results));
+
+    if (csvPath.isEmpty() && jsonPath.isEmpty())
+        std::cout << toCsv (results);
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+/*
+  ==============================================================================
+
+    Tests.cpp
+    Checks on parts of the DSP chain that don't need the TS9 captures
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+static int failures = 0;
+
+static void check (bool passed, const juce::String& what)
+{
+    std::cout << (passed ? "  ok    " : "  FAIL  ") << what << "\n";
+    failures += passed ? 0 : 1;
+}
+
+static void fillTestSignal (juce::AudioBuffer<float>& buffer)
+{
+    juce::Random random (1234);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int n = 0; n < buffer.getNumSamples(); ++n)
+            buffer.setSample (ch, n, 0.5f * std::sin (0.013f * (float) n * (float) (ch + 1))
+                                     + 0.1f * (random.nextFloat() - 0.5f));
+}
+
+
+//==============================================================================
+/** Hosts may send more than the block size they announced. FixedRateStage has to take
+    such a block in pieces that fit what it was prepared for, with the same result as
+    if the host had sent the pieces itself.
+*/
+static void testOversizedBlocks()
+{
+    std::cout << "FixedRateStage, blocks longer than prepared\n";
+
+    constexpr int maxBlockSize = 64, length = 5000, numChannels = 2;
+
+    for (auto rate : { 44100.0, 48000.0, 96000.0 })
+    {
+        FixedRateStage whole, pieces;
+        whole.prepare (rate, Two_inputAudioProcessor::modelSampleRate, FixedRateStage::Quality::normal, numChannels, maxBlockSize);
+        pieces.prepare (rate, Two_inputAudioProcessor::modelSampleRate, FixedRateStage::Quality::normal, numChannels, maxBlockSize);
+
+        juce::AudioBuffer<float> a (numChannels, length), b;
+        fillTestSignal (a);
+        b.makeCopyOf (a);
+
+        //something nonlinear in the middle, so the inner blocks matter
+        int largest = 0;
+        auto distort = [&largest] (float* const* channels, int numSamples)
+        {
+            largest = juce::jmax (largest, numSamples);
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int n = 0; n < numSamples; ++n)
+                    channels[ch][n] = std::tanh (3.0f * channels[ch][n]);
+        };
+
+        whole.process (a.getArrayOfWritePointers(), numChannels, length, distort);
+
+        for (int pos = 0; pos < length; pos += maxBlockSize)
+        {
+            float* channels[] { b.getWritePointer (0, pos), b.getWritePointer (1, pos) };
+            pieces.process (channels, numChannels, juce::jmin (maxBlockSize, length - pos), distort);
+        }
+
+        float difference = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int n = 0; n < length; ++n)
+                difference = juce::jmax (difference, std::abs (a.getSample (ch, n) - b.getSample (ch, n)));
+
+        const auto name = juce::String (rate / 1000.0, 1) + " kHz: ";
+        check (largest <= whole.getMaxInnerBlockSize(), name + "callback blocks within getMaxInnerBlockSize()");
+        check (difference == 0.0f, name + "same output as host-sized blocks");
+    }
+}
+
+
+//==============================================================================
+/** A network that goes idle in silence holds its output instead of computing it. What it
+    holds has to be what the network would have kept producing, whatever the block size,
+    and when signal comes back it has to wake up and carry on as the network would have.
+*/
+static void testIdleHold()
+{
+    std::cout << "NeuralModel, idle output against the free-running network\n";
+
+    using Model = NeuralModel<LSTMWeights<2, 64>>;
+    Model::Weights weights;
+    check (loadModelWeights (weights, "ts_nine_nsw", "ts_nine_json"), "TS9 weights load");
+
+    constexpr int numChannels = 2, signalLength = 4800, length = 4 * 48000, holdSamples = 9600;
+    constexpr int burstStart = 2 * 48000; //a second burst, long after the first has gone idle
+    constexpr float drive = 0.5f;
+
+    juce::AudioBuffer<float> input (numChannels, length);
+    input.clear();
+    juce::AudioBuffer<float> signal (numChannels, signalLength);
+    fillTestSignal (signal);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        input.copyFrom (ch, 0, signal, ch, 0, signalLength);
+        input.copyFrom (ch, burstStart, signal, ch, 0, signalLength);
+    }
+
+    for (auto blockSize : { 7, 32 })
+    {
+        Model held, free;
+        for (auto* model : { &held, &free })
+        {
+            model->setWeights (&weights);
+            model->prepare (numChannels, blockSize);
+        }
+        held.setIdleDetection (1.0e-4f, holdSamples);
+
+        juce::AudioBuffer<float> a, b;
+        a.makeCopyOf (input);
+        b.makeCopyOf (input);
+
+        int idleFrom = -1;
+        bool idleInBurst = false;
+        for (int pos = 0; pos < length; pos += blockSize)
+        {
+            const auto n = juce::jmin (blockSize, length - pos);
+            float* heldChannels[] { a.getWritePointer (0, pos), a.getWritePointer (1, pos) };
+            float* freeChannels[] { b.getWritePointer (0, pos), b.getWritePointer (1, pos) };
+            held.process (heldChannels, numChannels, n, drive);
+            free.process (freeChannels, numChannels, n, drive);
+
+            if (idleFrom < 0 && held.isAnyIdle())
+                idleFrom = pos;
+
+            if (pos >= burstStart && pos + n <= burstStart + signalLength)
+                idleInBurst = idleInBurst || held.isAnyIdle();
+        }
+
+        auto maxDifference = [&a, &b] (int start, int end)
+        {
+            float difference = 0.0f;
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int n = start; n < end; ++n)
+                    difference = juce::jmax (difference, std::abs (a.getSample (ch, n) - b.getSample (ch, n)));
+            return difference;
+        };
+
+        const auto heldDifference = maxDifference (signalLength, burstStart);
+        const auto burstDifference = maxDifference (burstStart, length);
+
+        const auto name = juce::String (blockSize) + " sample blocks: ";
+        check (idleFrom >= signalLength + holdSamples, name + "idles only after the hold time");
+        check (idleFrom >= 0 && idleFrom < burstStart, name + "idles before the second burst");
+        check (! idleInBurst, name + "wakes up for the second burst");
+        check (heldDifference < 1.0e-4f, name + "held output matches (max difference " + juce::String (heldDifference) + ")");
+        check (burstDifference < 1.0e-4f, name + "output from the second burst on matches (max difference "
+                                              + juce::String (burstDifference) + ")");
+    }
+}
+
+
+//==============================================================================
+/** Random weights for a cell + Dense model in the layout of the JSON exports, as the
+    text loadJson() and RTNeural parse and as numbers for a reference to use. A GRU has
+    Keras' two bias rows (reset_after), an LSTM a single one.
+*/
+struct RandomExport
+{
+    using Matrix = std::vector<std::vector<float>>;
+
+    Matrix kernel, recurrent, bias, dense; //[input][column], [unit][column], [row][column], [unit][0]
+    float denseBias {0.0f};
+    juce::String json;
+
+    RandomExport (const char* type, int inSize, int hiddenSize, int numColumns, int numBiasRows, int seed)
+    {
+        juce::Random random (seed);
+        auto matrix = [&random] (int rows, int columns)
+        {
+            Matrix m ((size_t) rows, std::vector<float> ((size_t) columns));
+            for (auto& row : m)
+                for (auto& x : row)
+                    x = 0.6f * (random.nextFloat() - 0.5f);
+            return m;
+        };
+
+        kernel = matrix (inSize, numColumns);
+        recurrent = matrix (hiddenSize, numColumns);
+        bias = matrix (numBiasRows, numColumns);
+        dense = matrix (hiddenSize, 1);
+        denseBias = 0.1f;
+
+        auto toJson = [] (const Matrix& m)
+        {
+            juce::StringArray rows;
+            for (auto& row : m)
+            {
+                juce::StringArray values;
+                for (auto x : row)
+                    values.add (juce::String (x, 9));
+                rows.add ("[" + values.joinIntoString (",") + "]");
+            }
+            return "[" + rows.joinIntoString (",") + "]";
+        };
+
+        const auto biasJson = numBiasRows == 1 ? toJson (bias).substring (1).dropLastCharacters (1) : toJson (bias);
+
+        json << "{\"in_shape\":[null,null," << inSize << "],\"layers\":["
+             << "{\"type\":\"" << type << "\",\"activation\":\"\",\"shape\":[null,null," << hiddenSize << "],"
+             << "\"weights\":[" << toJson (kernel) << "," << toJson (recurrent) << "," << biasJson << "]},"
+             << "{\"type\":\"dense\",\"activation\":\"\",\"shape\":[null,null,1],"
+             << "\"weights\":[" << toJson (dense) << ",[" << juce::String (denseBias, 9) << "]]}]}";
+    }
+
+    nlohmann::json parse() const { return nlohmann::json::parse (json.toStdString()); }
+};
+
+/** Keras' GRU with reset_after, one sample at a time in double precision. */
+struct ReferenceGRU
+{
+    explicit ReferenceGRU (const RandomExport& e) : w (e), h (e.recurrent.size(), 0.0) {}
+
+    float forward (const float* x, int inSize)
+    {
+        const auto H = h.size();
+        auto sigmoid = [] (double v) { return 1.0 / (1.0 + std::exp (-v)); };
+
+        std::vector<double> xw (3 * H), hu (3 * H);
+        for (size_t col = 0; col < 3 * H; ++col)
+        {
+            xw[col] = w.bias[0][col];
+            hu[col] = w.bias[1][col];
+
+            for (int k = 0; k < inSize; ++k)
+                xw[col] += (double) w.kernel[(size_t) k][col] * x[k];
+
+            for (size_t k = 0; k < H; ++k)
+                hu[col] += (double) w.recurrent[k][col] * h[k];
+        }
+
+        auto y = (double) w.denseBias;
+        for (size_t j = 0; j < H; ++j)
+        {
+            const auto z = sigmoid (xw[j] + hu[j]);
+            const auto r = sigmoid (xw[H + j] + hu[H + j]);
+            const auto n = std::tanh (xw[2 * H + j] + r * hu[2 * H + j]);
+            h[j] = z * h[j] + (1.0 - z) * n;
+        }
+
+        for (size_t j = 0; j < H; ++j)
+            y += w.dense[j][0] * h[j];
+
+        return (float) y;
+    }
+
+    const RandomExport& w;
+    std::vector<double> h;
+};
+
+/** The same network the LSTM engine runs, through RTNeural's own LSTM. */
+template <int hiddenSize>
+struct ReferenceLSTM
+{
+    explicit ReferenceLSTM (const RandomExport& e)
+    {
+        net.parseJson (e.parse());
+        net.reset();
+    }
+
+    float forward (const float* x, int) { return net.forward (x); }
+
+    RTNeural::ModelT<float, 2, 1,
+                    RTNeural::LSTMLayerT<float, 2, hiddenSize>,
+                    RTNeural::DenseT<float, hiddenSize, 1>> net;
+};
+
+/** Three channels (a pair and a padded single lane) through NeuralModel in odd sized
+    blocks, with every kernel this CPU has, against Reference run on each channel alone.
+*/
+template <typename Weights, typename Reference>
+static void checkAgainstReference (const RandomExport& e, const juce::String& name)
+{
+    auto weights = std::make_unique<Weights>();
+    check (weights->loadJson (e.parse()), name + ": loads");
+
+    constexpr int numChannels = 3, length = 2000, blockSize = 37;
+    constexpr float drive = 0.6f;
+
+    juce::AudioBuffer<float> input (numChannels, length);
+    fillTestSignal (input);
+
+    juce::AudioBuffer<float> expected (numChannels, length);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        Reference reference (e);
+        for (int n = 0; n < length; ++n)
+        {
+            const float x[] { input.getSample (ch, n), drive };
+            expected.setSample (ch, n, reference.forward (x, 2));
+        }
+    }
+
+    for (auto* kernel : LSTMKernel::getAvailable())
+    {
+        NeuralModel<Weights> model;
+        model.setWeights (weights.get());
+        model.setKernel (*kernel);
+        model.prepare (numChannels, blockSize);
+
+        juce::AudioBuffer<float> output;
+        output.makeCopyOf (input);
+
+        for (int pos = 0; pos < length; pos += blockSize)
+        {
+            float* channels[numChannels];
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[ch] = output.getWritePointer (ch, pos);
+
+            model.process (channels, numChannels, juce::jmin (blockSize, length - pos), drive);
+        }
+
+        float difference = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int n = 0; n < length; ++n)
+                difference = juce::jmax (difference, std::abs (output.getSample (ch, n) - expected.getSample (ch, n)));
+
+        check (difference < 1.0e-4f, name + ", " + kernel->name + ": matches (max difference " + juce::String (difference) + ")");
+    }
+}
+
+/** Keras' reset_after GRU and RTNeural's LSTM against the engine's blocked layouts, at a
+    size that is a multiple of 8 and one that takes the generic step.
+*/
+static void testAgainstReferences()
+{
+    std::cout << "NeuralModel against reference implementations, random weights\n";
+
+    checkAgainstReference<GRUWeights<2, 20>, ReferenceGRU> (RandomExport ("gru", 2, 20, 60, 2, 20), "GRU h20");
+    checkAgainstReference<GRUWeights<2, 24>, ReferenceGRU> (RandomExport ("gru", 2, 24, 72, 2, 24), "GRU h24");
+    checkAgainstReference<LSTMWeights<2, 20>, ReferenceLSTM<20>> (RandomExport ("lstm", 2, 20, 80, 1, 120), "LSTM h20");
+    checkAgainstReference<LSTMWeights<2, 24>, ReferenceLSTM<24>> (RandomExport ("lstm", 2, 24, 96, 1, 124), "LSTM h24");
+}
+
+
+//==============================================================================
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInit; //APVTS needs a message manager
+
+    testOversizedBlocks();
+    testIdleHold();
+    testAgainstReferences();
+
+    std::cout << (failures == 0 ? "\nall passed\n" : "\n" + juce::String (failures) + " failure(s)\n");
+    return failures == 0 ? 0 : 1;
+}
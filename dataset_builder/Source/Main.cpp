@@ -0,0 +1,521 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Streaming dataset builder: cuts input/target WAV pairs into the training
+    chunks Python/model.py loads, with flat memory use and a file per thread.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "NpzWriter.h"
+#include "Resampler.h"
+#include <complex>
+#include <limits>
+
+//==============================================================================
+/** Defaults are the constants at the top of Python/preprocessing.py. */
+struct DatasetSettings
+{
+    double sampleRate {44100.0};
+    int    chunkSize {22050};             //0.5 seconds
+    int    hopSize {22050};               //non-overlapping
+    int    maxMisalignment {55};          //samples
+    juce::String loadSubdir {"preproc"};
+};
+
+struct PairResult
+{
+    juce::File input, target;
+    float knob {0.0f};
+    int numChunks {0};
+    int numMisaligned {0};
+    juce::String error;
+
+    //inputs: numChunks x chunkSize x (sample, knob); targets: numChunks x chunkSize
+    std::unique_ptr<juce::TemporaryFile> inputs, targets;
+};
+
+
+//==============================================================================
+/**
+    Reads a file one block at a time as mono (the mean of its channels, like
+    librosa.load (mono=True)), resampled to the dataset's rate if it's at
+    another one, so memory use doesn't depend on the file's length.
+*/
+class MonoStream
+{
+public:
+    static constexpr int blockSize = 8192;
+
+    juce::String open (const juce::File& file, juce::AudioFormatManager& formats, double rate)
+    {
+        reader.reset (formats.createReaderFor (file));
+        if (reader == nullptr)
+            return "could not open " + file.getFileName();
+
+        block.setSize ((int) reader->numChannels, blockSize);
+        mono.resize ((size_t) blockSize);
+
+        resampling = juce::roundToInt (reader->sampleRate) != juce::roundToInt (rate);
+        length = resampling ? (juce::int64) std::ceil ((double) reader->lengthInSamples * rate / reader->sampleRate)
+                            : reader->lengthInSamples;
+
+        if (resampling)
+        {
+            resampler.prepare (reader->sampleRate, rate, FixedRateStage::getZeroCrossings (FixedRateStage::Quality::high),
+                               1, blockSize);
+            resampled.resize ((size_t) resampler.getMaxOutput (blockSize));
+        }
+
+        rewind();
+        return {};
+    }
+
+    /** Length at the dataset's rate. */
+    juce::int64 getLength() const noexcept { return length; }
+
+    void rewind()
+    {
+        readPosition = 0;
+        numConverted = 0;
+        pending.clear();
+        pendingStart = 0;
+
+        if (resampling)
+            resampler.reset();
+    }
+
+    /** Fills dest with up to numSamples and returns how many, fewer only at the end. */
+    int read (float* dest, int numSamples)
+    {
+        int done = 0;
+
+        while (done < numSamples)
+        {
+            if (pendingStart == pending.size() && ! refill())
+                break;
+
+            const auto n = juce::jmin ((size_t) (numSamples - done), pending.size() - pendingStart);
+            std::copy_n (pending.data() + pendingStart, n, dest + done);
+            pendingStart += n;
+            done += (int) n;
+        }
+
+        return done;
+    }
+
+    /** Skips numSamples, if that's more than 0. */
+    void skip (int numSamples)
+    {
+        float scratch[256];
+        while (numSamples > 0)
+        {
+            const auto n = read (scratch, juce::jmin (numSamples, 256));
+            if (n == 0)
+                break;
+            numSamples -= n;
+        }
+    }
+
+private:
+    /** Reads and converts the next block. False once the file is used up. */
+    bool refill()
+    {
+        pending.clear();
+        pendingStart = 0;
+
+        //past the end of the file the resampler is fed silence until it has given back
+        //everything it held on to
+        const auto available = reader->lengthInSamples - readPosition;
+        if (available <= 0 && (! resampling || numConverted >= length))
+            return false;
+
+        const auto n = (int) juce::jlimit ((juce::int64) 0, (juce::int64) blockSize, available);
+        std::fill (mono.begin(), mono.end(), 0.0f);
+
+        if (n > 0)
+        {
+            reader->read (&block, 0, n, readPosition, true, true);
+            readPosition += n;
+
+            const auto scale = 1.0f / (float) block.getNumChannels();
+            for (int ch = 0; ch < block.getNumChannels(); ++ch)
+                juce::FloatVectorOperations::addWithMultiply (mono.data(), block.getReadPointer (ch), scale, n);
+        }
+
+        if (! resampling)
+        {
+            pending.assign (mono.begin(), mono.begin() + n);
+            return n > 0;
+        }
+
+        const float* in[] = { mono.data() };
+        float* out[] = { resampled.data() };
+        const auto numOut = resampler.process (in, blockSize, out, 1);
+
+        //only as much as the resampled file is long, the rest is the filter ringing out
+        const auto wanted = (int) juce::jmin ((juce::int64) numOut, length - numConverted);
+        pending.assign (resampled.begin(), resampled.begin() + juce::jmax (0, wanted));
+        numConverted += (juce::int64) pending.size();
+        return true;
+    }
+
+    std::unique_ptr<juce::AudioFormatReader> reader;
+    juce::AudioBuffer<float> block;
+    std::vector<float> mono, resampled, pending;
+    size_t pendingStart {0};
+    juce::int64 readPosition {0}, numConverted {0}, length {0};
+
+    bool resampling {false};
+    PolyphaseResampler resampler;
+};
+
+
+//==============================================================================
+/**
+    The lag of the target against the input over one chunk, at the peak of
+    their cross-correlation, the same as np.argmax (np.correlate (x, y, 'full'))
+    - (len (x) - 1) but through an FFT, so each chunk costs O(n log n).
+*/
+class LagEstimator
+{
+public:
+    explicit LagEstimator (int chunkSize)
+        : size (chunkSize),
+          order (juce::jmax (1, (int) std::ceil (std::log2 (2.0 * chunkSize - 1.0)))),
+          fft (order)
+    {
+        const auto fftSize = (size_t) fft.getSize();
+        x.resize (2 * fftSize);
+        y.resize (2 * fftSize);
+    }
+
+    int estimate (const float* input, const float* target)
+    {
+        const auto fftSize = fft.getSize();
+        std::fill (x.begin(), x.end(), 0.0f);
+        std::fill (y.begin(), y.end(), 0.0f);
+        std::copy_n (input, size, x.data());
+        std::copy_n (target, size, y.data());
+
+        fft.performRealOnlyForwardTransform (x.data(), true);
+        fft.performRealOnlyForwardTransform (y.data(), true);
+
+        //X times the conjugate of Y
+        auto* X = reinterpret_cast<std::complex<float>*> (x.data());
+        auto* Y = reinterpret_cast<std::complex<float>*> (y.data());
+        for (int bin = 0; bin <= fftSize / 2; ++bin)
+            X[bin] *= std::conj (Y[bin]);
+
+        fft.performRealOnlyInverseTransform (x.data());
+
+        //lag k >= 0 lands in bin k, lag k < 0 in bin fftSize + k; scanned from the most
+        //negative lag up so ties go the same way as np.argmax
+        int best = 0;
+        float peak = -std::numeric_limits<float>::infinity();
+
+        for (int lag = -(size - 1); lag < size; ++lag)
+        {
+            const auto value = x[(size_t) (lag < 0 ? fftSize + lag : lag)];
+            if (value > peak)
+            {
+                peak = value;
+                best = lag;
+            }
+        }
+
+        return best;
+    }
+
+private:
+    const int size, order;
+    juce::dsp::FFT fft;
+    std::vector<float> x, y;
+};
+
+
+//==============================================================================
+/**
+    Turns one input/target pair into chunks, written to two temporary files so
+    that all pairs can run side by side and still end up in the dataset in
+    order. The first pass only finds the peak both are normalised by, the
+    second cuts the chunks, so neither ever holds more than a chunk.
+*/
+class PairJob : public juce::ThreadPoolJob
+{
+public:
+    PairJob (const DatasetSettings& s, const juce::File& outputFile, PairResult& r)
+        : juce::ThreadPoolJob (r.input.getFileName()), settings (s), output (outputFile), result (r)
+    {
+    }
+
+    JobStatus runJob() override
+    {
+        result.error = build();
+        return jobHasFinished;
+    }
+
+private:
+    juce::String build()
+    {
+        //the knob position is the second '-' separated field of the name, e.g. TS9_A-0.5-input.wav
+        const auto fields = juce::StringArray::fromTokens (result.input.getFileNameWithoutExtension(), "-", {});
+        if (fields.size() < 3)
+            return "no knob position in the file name";
+        result.knob = fields[1].getFloatValue();
+
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        MonoStream x, y;
+        auto error = x.open (result.input, formats, settings.sampleRate);
+        if (error.isEmpty())
+            error = y.open (result.target, formats, settings.sampleRate);
+        if (error.isNotEmpty())
+            return error;
+
+        const auto length = juce::jmin (x.getLength(), y.getLength());
+        if (length < settings.chunkSize)
+            return "shorter than a chunk";
+
+        //Pass 1: normalise both globally by the larger peak
+        const auto peak = juce::jmax (getPeak (x, length), getPeak (y, length));
+        if (peak <= 0.0f)
+            return "silent";
+
+        x.rewind();
+        y.rewind();
+
+        //Pass 2: chunk
+        result.inputs  = std::make_unique<juce::TemporaryFile> (output);
+        result.targets = std::make_unique<juce::TemporaryFile> (output);
+        juce::FileOutputStream inputsOut (result.inputs->getFile()), targetsOut (result.targets->getFile());
+        if (! inputsOut.openedOk() || ! targetsOut.openedOk())
+            return "could not create temporary files";
+
+        const auto chunkSize = settings.chunkSize;
+        const auto hopSize = settings.hopSize;
+        std::vector<float> xChunk ((size_t) chunkSize), yChunk ((size_t) chunkSize);
+        std::vector<float> inputFrames (2 * (size_t) chunkSize), targetFrames ((size_t) chunkSize);
+        LagEstimator lags (chunkSize);
+
+        for (juce::int64 start = 0; start + chunkSize <= length; start += hopSize)
+        {
+            if (shouldExit())
+                return "cancelled";
+
+            //slide the window on by hopSize, reading only what's new
+            auto kept = 0;
+            if (start > 0)
+            {
+                kept = juce::jmax (0, chunkSize - hopSize);
+                std::copy (xChunk.end() - kept, xChunk.end(), xChunk.begin());
+                std::copy (yChunk.end() - kept, yChunk.end(), yChunk.begin());
+                x.skip (hopSize - chunkSize);
+                y.skip (hopSize - chunkSize);
+            }
+
+            const auto needed = chunkSize - kept;
+            if (x.read (xChunk.data() + kept, needed) < needed || y.read (yChunk.data() + kept, needed) < needed)
+                break;
+
+            //the lag doesn't depend on the scale, so the chunk is checked before it's normalised
+            if (std::abs (lags.estimate (xChunk.data(), yChunk.data())) > settings.maxMisalignment)
+            {
+                ++result.numMisaligned;
+                continue;
+            }
+
+            for (int i = 0; i < chunkSize; ++i)
+            {
+                inputFrames[2 * (size_t) i]     = xChunk[(size_t) i] / peak;
+                inputFrames[2 * (size_t) i + 1] = result.knob;
+                targetFrames[(size_t) i]        = yChunk[(size_t) i] / peak;
+            }
+
+            inputsOut.write (inputFrames.data(), inputFrames.size() * sizeof (float));
+            targetsOut.write (targetFrames.data(), targetFrames.size() * sizeof (float));
+            ++result.numChunks;
+        }
+
+        inputsOut.flush();
+        targetsOut.flush();
+        if (inputsOut.getStatus().failed() || targetsOut.getStatus().failed())
+            return "could not write temporary files";
+
+        return {};
+    }
+
+    float getPeak (MonoStream& stream, juce::int64 length)
+    {
+        std::vector<float> block ((size_t) MonoStream::blockSize);
+        float peak = 0.0f;
+
+        for (juce::int64 pos = 0; pos < length;)
+        {
+            const auto n = stream.read (block.data(), (int) juce::jmin ((juce::int64) MonoStream::blockSize, length - pos));
+            if (n == 0)
+                break;
+
+            const auto range = juce::FloatVectorOperations::findMinAndMax (block.data(), n);
+            peak = juce::jmax (peak, -range.getStart(), range.getEnd());
+            pos += n;
+        }
+
+        return peak;
+    }
+
+    const DatasetSettings& settings;
+    const juce::File output;
+    PairResult& result;
+};
+
+
+//==============================================================================
+static void printUsage()
+{
+    std::cout << "usage: NeuralScreamerDataset [options] [audio directory]\n"
+                 "  Finds *-input.wav / *-target.wav pairs in every 'preproc' folder under the\n"
+                 "  audio directory (default ./audio) and writes them as one .npz for Python/model.py\n"
+                 "  --out=<file>            dataset to write (default ./audio/postproc/test-dataset.npz)\n"
+                 "  --chunk=<samples>       chunk length (default 22050)\n"
+                 "  --hop=<samples>         distance between chunk starts (default: the chunk length)\n"
+                 "  --max-misalignment=<n>  skip chunks whose target lags more than this (default 55)\n"
+                 "  --subdir=<name>         folders to collect pairs from (default preproc)\n"
+                 "  --threads=<n>           pairs processed at once (default: all cores)\n";
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+    if (args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    DatasetSettings settings;
+    auto option = [&args] (const juce::String& name, const juce::String& fallback)
+    {
+        auto value = args.getValueForOption (name);
+        return value.isEmpty() ? fallback : value;
+    };
+
+    settings.chunkSize       = juce::jmax (2, option ("--chunk", "22050").getIntValue());
+    settings.hopSize         = juce::jmax (1, option ("--hop", juce::String (settings.chunkSize)).getIntValue());
+    settings.maxMisalignment = juce::jmax (0, option ("--max-misalignment", "55").getIntValue());
+    settings.loadSubdir      = option ("--subdir", "preproc");
+
+    const auto numThreads = juce::jmax (1, option ("--threads", juce::String (juce::SystemStats::getNumCpus())).getIntValue());
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    const auto output = cwd.getChildFile (option ("--out", "audio/postproc/test-dataset.npz"));
+
+    juce::File audioDir = cwd.getChildFile ("audio");
+    for (auto& arg : args.arguments)
+        if (! arg.isOption())
+            audioDir = arg.resolveAsFile();
+
+    //Collect the pairs, sorted by name like preprocessing.py
+    juce::Array<juce::File> inputs;
+    for (const auto& entry : juce::RangedDirectoryIterator (audioDir, true, "*-input.wav"))
+        if (entry.getFile().getParentDirectory().getFileName() == settings.loadSubdir)
+            inputs.add (entry.getFile());
+
+    std::sort (inputs.begin(), inputs.end(), [] (const juce::File& a, const juce::File& b)
+               { return a.getFileName() < b.getFileName(); });
+
+    std::vector<PairResult> results;
+    for (auto& in : inputs)
+    {
+        const auto target = in.getSiblingFile (in.getFileName().replace ("-input.wav", "-target.wav"));
+        if (! target.existsAsFile())
+        {
+            std::cout << "Missing target for: " << in.getFileName() << "\n";
+            continue;
+        }
+
+        results.emplace_back();
+        results.back().input = in;
+        results.back().target = target;
+    }
+
+    if (results.empty())
+    {
+        std::cout << "No input/target pairs found under " << audioDir.getFullPathName() << "\n";
+        return 1;
+    }
+
+    output.getParentDirectory().createDirectory();
+    const auto t0 = juce::Time::getHighResolutionTicks();
+
+    {
+        juce::ThreadPool pool (juce::ThreadPoolOptions{}.withNumberOfThreads (juce::jmin (numThreads, (int) results.size())));
+
+        for (auto& r : results)
+            pool.addJob (new PairJob (settings, output, r), true);
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (20);
+    }
+
+    //Gather the pairs' chunks into the dataset, in order
+    juce::int64 numChunks = 0;
+    for (auto& r : results)
+    {
+        if (r.error.isNotEmpty())
+        {
+            std::cout << r.input.getFileName() << ": skipped (" << r.error << ")\n";
+            continue;
+        }
+
+        std::cout << r.input.getFileName() << ": knob " << r.knob << ", " << r.numChunks << " chunk(s), "
+                  << r.numMisaligned << " skipped for misalignment\n";
+        numChunks += r.numChunks;
+    }
+
+    if (numChunks == 0)
+    {
+        std::cout << "No valid chunks found.\n";
+        return 1;
+    }
+
+    NpzWriter npz (output);
+    if (! npz.openedOk())
+    {
+        std::cout << "could not create " << output.getFullPathName() << "\n";
+        return 1;
+    }
+
+    auto writeArray = [&] (const juce::String& name, int width, std::unique_ptr<juce::TemporaryFile> PairResult::* spool)
+    {
+        npz.beginArray (name, { numChunks, (juce::int64) settings.chunkSize, (juce::int64) width });
+
+        for (auto& r : results)
+        {
+            if (r.error.isNotEmpty() || r.*spool == nullptr)
+                continue;
+
+            juce::FileInputStream in ((r.*spool)->getFile());
+            npz.writeFrom (in);
+        }
+
+        npz.endArray();
+    };
+
+    writeArray ("inputs", 2, &PairResult::inputs);
+    writeArray ("targets", 1, &PairResult::targets);
+
+    if (! npz.finish())
+    {
+        std::cout << "could not write " << output.getFullPathName() << "\n";
+        return 1;
+    }
+
+    const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - t0);
+    std::cout << "Final dataset: X=(" << numChunks << ", " << settings.chunkSize << ", 2), Y=(" << numChunks << ", "
+              << settings.chunkSize << ", 1) in " << juce::String (seconds, 2) << " s\n"
+              << "Saved dataset to: " << output.getFullPathName() << "\n";
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+  ==============================================================================
+
+    NpzWriter.h
+    Writes float32 arrays into a NumPy .npz file a piece at a time
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+
+/**
+    An .npz is a zip archive of .npy files, stored without compression, which
+    is what np.savez writes and np.load reads. This writes one array after the
+    other straight to the file, so an array can be far larger than memory: only
+    its shape has to be known when it's started.
+
+    Every entry carries ZIP64 sizes, so arrays past 4 GB are fine. The CRC and
+    the sizes are patched into each entry's header once it's finished, which is
+    why the output has to be a file rather than any stream.
+*/
+class NpzWriter
+{
+public:
+    explicit NpzWriter (const juce::File& file)
+    {
+        file.deleteFile();
+        stream = std::make_unique<juce::FileOutputStream> (file);
+    }
+
+    bool openedOk() const { return stream->openedOk(); }
+
+    /** Starts the array name.npy with the given shape. Arrays can't be nested. */
+    void beginArray (const juce::String& name, const std::vector<juce::int64>& shape)
+    {
+        jassert (! inArray);
+        inArray = true;
+
+        Entry entry;
+        entry.name = name + ".npy";
+        entry.headerOffset = stream->getPosition();
+        entries.push_back (entry);
+
+        //local header: the CRC and sizes are filled in by endArray()
+        stream->writeInt (0x04034b50);
+        stream->writeShort (zip64Version);
+        stream->writeShort (0);                           //flags
+        stream->writeShort (0);                           //stored
+        writeDosTime();
+        stream->writeInt (0);                             //CRC
+        stream->writeInt ((int) 0xffffffff);              //sizes are in the ZIP64 field
+        stream->writeInt ((int) 0xffffffff);
+        stream->writeShort ((short) entry.name.getNumBytesAsUTF8());
+        stream->writeShort (20);
+        stream->write (entry.name.toRawUTF8(), entry.name.getNumBytesAsUTF8());
+        stream->writeShort (0x0001);
+        stream->writeShort (16);
+        stream->writeInt64 (0);
+        stream->writeInt64 (0);
+
+        dataStart = stream->getPosition();
+        crc = 0xffffffff;
+
+        writeNpyHeader (shape);
+    }
+
+    /** Appends to the array being written. */
+    void write (const void* data, size_t numBytes)
+    {
+        jassert (inArray);
+        updateCrc (static_cast<const juce::uint8*> (data), numBytes);
+        stream->write (data, numBytes);
+    }
+
+    /** Appends everything left in source. */
+    void writeFrom (juce::InputStream& source)
+    {
+        juce::HeapBlock<char> buffer (copyBlockSize);
+
+        for (;;)
+        {
+            const auto numRead = source.read (buffer.get(), copyBlockSize);
+            if (numRead <= 0)
+                break;
+
+            write (buffer.get(), (size_t) numRead);
+        }
+    }
+
+    /** Finishes the array being written. */
+    void endArray()
+    {
+        jassert (inArray);
+        inArray = false;
+
+        auto& entry = entries.back();
+        entry.crc = crc ^ 0xffffffff;
+        entry.size = stream->getPosition() - dataStart;
+
+        const auto end = stream->getPosition();
+        stream->setPosition (entry.headerOffset + 14);
+        stream->writeInt ((int) entry.crc);
+        stream->setPosition (dataStart - 16);
+        stream->writeInt64 (entry.size);
+        stream->writeInt64 (entry.size);
+        stream->setPosition (end);
+    }
+
+    /** Writes the central directory. True if everything made it to disk. */
+    bool finish()
+    {
+        jassert (! inArray);
+        const auto directoryStart = stream->getPosition();
+
+        for (auto& entry : entries)
+        {
+            stream->writeInt (0x02014b50);
+            stream->writeShort (zip64Version);            //made by
+            stream->writeShort (zip64Version);            //needed
+            stream->writeShort (0);
+            stream->writeShort (0);
+            writeDosTime();
+            stream->writeInt ((int) entry.crc);
+            stream->writeInt ((int) 0xffffffff);
+            stream->writeInt ((int) 0xffffffff);
+            stream->writeShort ((short) entry.name.getNumBytesAsUTF8());
+            stream->writeShort (28);
+            stream->writeShort (0);                       //comment
+            stream->writeShort (0);                       //disk
+            stream->writeShort (0);                       //internal attributes
+            stream->writeInt (0);                         //external attributes
+            stream->writeInt ((int) 0xffffffff);          //offset is in the ZIP64 field
+            stream->write (entry.name.toRawUTF8(), entry.name.getNumBytesAsUTF8());
+            stream->writeShort (0x0001);
+            stream->writeShort (24);
+            stream->writeInt64 (entry.size);
+            stream->writeInt64 (entry.size);
+            stream->writeInt64 (entry.headerOffset);
+        }
+
+        const auto directoryEnd = stream->getPosition();
+        const auto numEntries = (juce::int64) entries.size();
+
+        //ZIP64 end of central directory record and its locator
+        stream->writeInt (0x06064b50);
+        stream->writeInt64 (44);
+        stream->writeShort (zip64Version);
+        stream->writeShort (zip64Version);
+        stream->writeInt (0);
+        stream->writeInt (0);
+        stream->writeInt64 (numEntries);
+        stream->writeInt64 (numEntries);
+        stream->writeInt64 (directoryEnd - directoryStart);
+        stream->writeInt64 (directoryStart);
+
+        stream->writeInt (0x07064b50);
+        stream->writeInt (0);
+        stream->writeInt64 (directoryEnd);
+        stream->writeInt (1);
+
+        //and the classic one, pointing at them
+        stream->writeInt (0x06054b50);
+        stream->writeShort (0);
+        stream->writeShort (0);
+        stream->writeShort ((short) numEntries);
+        stream->writeShort ((short) numEntries);
+        stream->writeInt ((int) 0xffffffff);
+        stream->writeInt ((int) 0xffffffff);
+        stream->writeShort (0);
+
+        stream->flush();
+        return stream->getStatus().wasOk();
+    }
+
+private:
+    static constexpr short zip64Version = 45;
+    static constexpr int copyBlockSize = 1 << 20;
+
+    struct Entry
+    {
+        juce::String name;
+        juce::int64 headerOffset {0}, size {0};
+        juce::uint32 crc {0};
+    };
+
+    /** Version 1.0 header for a little-endian float32 array, padded to 64 bytes like NumPy's. */
+    void writeNpyHeader (const std::vector<juce::int64>& shape)
+    {
+        //a 1-d shape keeps its trailing comma, as in Python
+        juce::StringArray dims;
+        for (auto d : shape)
+            dims.add (juce::String (d));
+
+        const auto tuple = shape.size() == 1 ? dims[0] + "," : dims.joinIntoString (", ");
+        auto header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" + tuple + "), }";
+        const auto prefixSize = 10;
+        const auto padded = (prefixSize + header.length() + 1 + 63) / 64 * 64;
+        header = header.paddedRight (' ', padded - prefixSize - 1) + "\n";
+
+        juce::MemoryOutputStream npy;
+        npy.write ("\x93NUMPY\x01\x00", 8);
+        npy.writeShort ((short) header.length());
+        npy << header;
+        write (npy.getData(), npy.getDataSize());
+    }
+
+    void writeDosTime()
+    {
+        const auto now = juce::Time::getCurrentTime();
+        stream->writeShort ((short) ((now.getHours() << 11) | (now.getMinutes() << 5) | (now.getSeconds() / 2)));
+        stream->writeShort ((short) (((now.getYear() - 1980) << 9) | ((now.getMonth() + 1) << 5) | now.getDayOfMonth()));
+    }
+
+    void updateCrc (const juce::uint8* data, size_t numBytes) noexcept
+    {
+        static const auto table = []
+        {
+            std::array<juce::uint32, 256> t {};
+            for (juce::uint32 i = 0; i < 256; ++i)
+            {
+                auto c = i;
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+
+        for (size_t i = 0; i < numBytes; ++i)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::vector<Entry> entries;
+    juce::int64 dataStart {0};
+    juce::uint32 crc {0xffffffff};
+    bool inArray {false};
+
+    JUCE_DECLARE_NON_COPYABLE (NpzWriter)
+};
@@ -0,0 +1,576 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+    Headless offline renderer: streams WAV files through
+    Two_inputAudioProcessor on a pool of worker threads.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include <limits>
+#include <numeric>
+
+//==============================================================================
+struct RenderSettings
+{
+    float drive  {0.5f};
+    float volume {1.0f};
+    float tone   {20000.0f};
+    bool  ts9    {true};
+    int   blockSize {4096};
+    int   channelThreads {0};
+    juce::File outputDir;
+
+    //Chunked rendering, see ChunkedRender
+    bool   chunked {false};
+    double chunkSeconds     {0.0};   //0 for one chunk per thread
+    double warmupSeconds    {0.5};
+    double crossfadeSeconds {0.01};
+    bool   verify {false};
+};
+
+struct RenderResult
+{
+    juce::File input, output;
+    double audioSeconds {0.0};
+    double wallSeconds  {0.0};
+    PerformanceMonitor::Snapshot performance;
+    juce::String error;
+
+    //Chunked renders only
+    int numChunks {0};
+    double serialSeconds {0.0};      //with verify
+    float maxErrorDb {-200.0f}, rmsErrorDb {-200.0f};
+
+    double realtimeFactor() const { return wallSeconds > 0.0 ? audioSeconds / wallSeconds : 0.0; }
+};
+
+
+//==============================================================================
+static void setParam (juce::AudioProcessorValueTreeState& apvts, const juce::String& id, float value)
+{
+    auto* param = apvts.getParameter (id);
+    param->setValueNotifyingHost (param->convertTo0to1 (value));
+}
+
+static juce::AudioProcessor::BusesLayout layoutFor (int numChannels)
+{
+    juce::AudioProcessor::BusesLayout layout;
+    layout.inputBuses.add  (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+    layout.outputBuses.add (juce::AudioChannelSet::canonicalChannelSet (numChannels));
+    return layout;
+}
+
+
+/** Sets a processor up the same way a host would. False if it can't take numChannels. */
+static bool prepareProcessor (Two_inputAudioProcessor& processor, const RenderSettings& settings,
+                              int numChannels, double sampleRate)
+{
+    if (! processor.setBusesLayout (layoutFor (numChannels)))
+        return false;
+
+    setParam (processor.apvts, "DRIVE",  settings.drive);
+    setParam (processor.apvts, "VOLUME", settings.volume);
+    setParam (processor.apvts, "TONE",   settings.tone);
+    setParam (processor.apvts, "TS9",    settings.ts9 ? 1.0f : 0.0f);
+    setParam (processor.apvts, "MINI",   settings.ts9 ? 0.0f : 1.0f);
+
+    processor.setNonRealtime (true);
+    processor.setWorkerThreads (settings.channelThreads);
+    processor.setRateAndBufferSizeDetails (sampleRate, settings.blockSize);
+    processor.prepareToPlay (sampleRate, settings.blockSize);
+    return true;
+}
+
+/** Runs samples [start, start + length) of audio through the processor in place,
+    in blocks of blockSize. The processor's latency is taken out: it's fed that
+    much silence after them, and the output is moved back by as much, so each
+    sample lands where its input was.
+*/
+static void processRange (Two_inputAudioProcessor& processor, juce::AudioBuffer<float>& audio,
+                          int start, int length, int blockSize)
+{
+    const auto latency = processor.getLatencySamples();
+    const auto numChannels = audio.getNumChannels();
+    juce::AudioBuffer<float> block (numChannels, blockSize);
+    juce::MidiBuffer midi;
+
+    for (int pos = 0; pos < length + latency; pos += blockSize)
+    {
+        const auto n = juce::jmin (blockSize, length + latency - pos);
+        const auto numInput = juce::jlimit (0, n, length - pos);
+        block.setSize (numChannels, n, false, false, true);
+        block.clear();
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            block.copyFrom (ch, 0, audio, ch, start + pos, numInput);
+
+        processor.processBlock (block, midi);
+
+        //block sample i is the output for input pos + i - latency, which has already been read
+        const auto first = juce::jmax (0, latency - pos);
+        if (first < n)
+            for (int ch = 0; ch < numChannels; ++ch)
+                audio.copyFrom (ch, start + pos + first - latency, block, ch, first, n - first);
+    }
+}
+
+
+//==============================================================================
+/** Renders one file start to finish with its own processor instance. */
+class RenderJob : public juce::ThreadPoolJob
+{
+public:
+    RenderJob (const juce::File& in, const RenderSettings& s, RenderResult& r)
+    : juce::ThreadPoolJob (in.getFileName()), settings (s), result (r)
+    {
+        result.input = in;
+        result.output = settings.outputDir.getChildFile (in.getFileNameWithoutExtension() + "-ns.wav");
+    }
+
+    JobStatus runJob() override
+    {
+        const auto t0 = juce::Time::getHighResolutionTicks();
+        result.error = render();
+        const auto t1 = juce::Time::getHighResolutionTicks();
+        result.wallSeconds = juce::Time::highResolutionTicksToSeconds (t1 - t0);
+        return jobHasFinished;
+    }
+
+private:
+    juce::String render()
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (result.input));
+        if (reader == nullptr)
+            return "could not open input";
+
+        const auto numChannels = (int) reader->numChannels;
+        if (numChannels < 1 || numChannels > 2)
+            return "only mono and stereo files are supported";
+
+        Two_inputAudioProcessor processor;
+        if (! prepareProcessor (processor, settings, numChannels, reader->sampleRate))
+            return "unsupported channel layout";
+
+        result.output.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (result.output.createOutputStream());
+        if (stream == nullptr)
+            return "could not create output";
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), reader->sampleRate,
+                                                                               (unsigned int) numChannels, 24, {}, 0));
+        if (writer == nullptr)
+            return "could not create wav writer";
+        stream.release(); //writer owns the stream now
+
+        //Stream the file through in large blocks. The processor's latency is taken out by
+        //running that much silence past the end (the reader fills it in) and not writing
+        //the first that many samples
+        const auto latency = (juce::int64) processor.getLatencySamples();
+        const auto length = reader->lengthInSamples;
+        juce::AudioBuffer<float> buffer (numChannels, settings.blockSize);
+        juce::MidiBuffer midi;
+
+        for (juce::int64 pos = 0; pos < length + latency; pos += settings.blockSize)
+        {
+            if (shouldExit())
+                return "cancelled";
+
+            const auto n = (int) juce::jmin ((juce::int64) settings.blockSize, length + latency - pos);
+            buffer.setSize (numChannels, n, false, false, true);
+            reader->read (&buffer, 0, n, pos, true, numChannels > 1);
+            processor.processBlock (buffer, midi);
+
+            const auto skip = (int) juce::jlimit ((juce::int64) 0, (juce::int64) n, latency - pos);
+            writer->writeFromAudioSampleBuffer (buffer, skip, n - skip);
+
+            //we're the only consumer, draining every block keeps the snapshot current
+            result.performance = processor.getPerformanceMonitor().getSnapshot();
+        }
+
+        processor.releaseResources();
+        result.audioSeconds = (double) reader->lengthInSamples / reader->sampleRate;
+        return {};
+    }
+
+    const RenderSettings& settings;
+    RenderResult& result;
+};
+
+
+//==============================================================================
+/**
+    Renders one long file as chunks side by side on every thread of a pool.
+
+    The networks are stateful, so a chunk can't simply start cold where the last
+    one ends. Each chunk's processor is started warmupSeconds early on the input
+    before it, and that output is thrown away, the same way Python/model.py warms
+    the model up before every training batch. The last crossfadeSeconds of the
+    warm-up are kept and faded into the end of the chunk before, so whatever
+    difference is left between the two doesn't click.
+
+    Chunks are started on a multiple of the period the host and model rates line
+    up on, so the resamplers see the same phases a serial render would. With
+    verify the whole file is also rendered serially, and the largest and RMS
+    differences to it are reported.
+*/
+class ChunkedRender
+{
+public:
+    ChunkedRender (const juce::File& in, const RenderSettings& s, RenderResult& r)
+        : settings (s), result (r)
+    {
+        result.input = in;
+        result.output = settings.outputDir.getChildFile (in.getFileNameWithoutExtension() + "-ns.wav");
+    }
+
+    void run (juce::ThreadPool& pool)
+    {
+        const auto t0 = juce::Time::getHighResolutionTicks();
+        result.error = render (pool);
+        const auto t1 = juce::Time::getHighResolutionTicks();
+        result.wallSeconds = juce::Time::highResolutionTicksToSeconds (t1 - t0) - result.serialSeconds;
+    }
+
+private:
+    struct Chunk
+    {
+        int renderStart, fadeStart, start, end;  //warm-up from renderStart, crossfade from fadeStart, kept from start
+        juce::AudioBuffer<float> fadeIn;
+        PerformanceMonitor::Snapshot performance;
+        bool failed {false};
+    };
+
+    juce::String render (juce::ThreadPool& pool)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (result.input));
+        if (reader == nullptr)
+            return "could not open input";
+
+        numChannels = (int) reader->numChannels;
+        if (numChannels < 1 || numChannels > 2)
+            return "only mono and stereo files are supported";
+
+        if (reader->lengthInSamples > std::numeric_limits<int>::max())
+            return "too long to render in chunks";
+
+        sampleRate = reader->sampleRate;
+        const auto length = (int) reader->lengthInSamples;
+        input.setSize (numChannels, length);
+        reader->read (&input, 0, length, 0, true, numChannels > 1);
+        output.setSize (numChannels, length);
+        reader.reset();
+
+        planChunks (length, pool.getNumThreads());
+
+        for (auto& chunk : chunks)
+            pool.addJob ([this, &chunk] { renderChunk (chunk); });
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (5);
+
+        for (auto& chunk : chunks)
+        {
+            if (chunk.failed)
+                return "unsupported channel layout";
+
+            result.performance.numBlocks      += chunk.performance.numBlocks;
+            result.performance.networkSeconds += chunk.performance.networkSeconds;
+            result.performance.otherSeconds   += chunk.performance.otherSeconds;
+        }
+
+        stitch();
+        result.numChunks = (int) chunks.size();
+        result.audioSeconds = (double) length / sampleRate;
+
+        if (settings.verify)
+            compareWithSerial();
+
+        return write();
+    }
+
+    /** Chunks of chunkSeconds (or an equal share per thread), never shorter than a few warm-ups. */
+    void planChunks (int length, int numThreads)
+    {
+        const auto warmup    = juce::roundToInt (settings.warmupSeconds * sampleRate);
+        const auto crossfade = juce::jmax (1, juce::roundToInt (settings.crossfadeSeconds * sampleRate));
+
+        auto chunkLength = settings.chunkSeconds > 0.0 ? juce::roundToInt (settings.chunkSeconds * sampleRate)
+                                                       : (length + numThreads - 1) / numThreads;
+        chunkLength = juce::jmax (chunkLength, 4 * (warmup + crossfade));
+
+        //host samples after which the model rate's samples land on the same instants again
+        const auto hostRate = juce::roundToInt (sampleRate);
+        const auto period = hostRate / std::gcd (hostRate, juce::roundToInt (Two_inputAudioProcessor::modelSampleRate));
+
+        chunks.clear();
+        chunks.reserve ((size_t) ((length + chunkLength - 1) / chunkLength));
+
+        for (int start = 0; start < length; start += chunkLength)
+        {
+            Chunk chunk;
+            chunk.start = start;
+            chunk.end = juce::jmin (length, start + chunkLength);
+            chunk.fadeStart = juce::jmax (0, start - crossfade);
+            chunk.renderStart = juce::jmax (0, chunk.fadeStart - warmup) / period * period;
+            chunks.push_back (std::move (chunk));
+        }
+    }
+
+    void renderChunk (Chunk& chunk)
+    {
+        Two_inputAudioProcessor processor;
+        if (! prepareProcessor (processor, settings, numChannels, sampleRate))
+        {
+            chunk.failed = true;
+            return;
+        }
+
+        const auto renderLength = chunk.end - chunk.renderStart;
+        juce::AudioBuffer<float> audio (numChannels, renderLength);
+        for (int ch = 0; ch < numChannels; ++ch)
+            audio.copyFrom (ch, 0, input, ch, chunk.renderStart, renderLength);
+
+        processRange (processor, audio, 0, renderLength, settings.blockSize);
+        chunk.performance = processor.getPerformanceMonitor().getSnapshot();
+        processor.releaseResources();
+
+        //chunks write disjoint parts of the output, the crossfades are done afterwards
+        const auto fadeLength = chunk.start - chunk.fadeStart;
+        chunk.fadeIn.setSize (numChannels, fadeLength);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            chunk.fadeIn.copyFrom (ch, 0, audio, ch, chunk.fadeStart - chunk.renderStart, fadeLength);
+            output.copyFrom (ch, chunk.start, audio, ch, chunk.start - chunk.renderStart, chunk.end - chunk.start);
+        }
+    }
+
+    /** Fades each chunk in over the end of the one before it. */
+    void stitch()
+    {
+        for (auto& chunk : chunks)
+        {
+            const auto fadeLength = chunk.fadeIn.getNumSamples();
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* out = output.getWritePointer (ch, chunk.fadeStart);
+                const auto* in = chunk.fadeIn.getReadPointer (ch);
+
+                for (int i = 0; i < fadeLength; ++i)
+                {
+                    const auto fade = ((float) i + 0.5f) / (float) fadeLength;
+                    out[i] += (in[i] - out[i]) * fade;
+                }
+            }
+        }
+    }
+
+    void compareWithSerial()
+    {
+        const auto t0 = juce::Time::getHighResolutionTicks();
+
+        Two_inputAudioProcessor processor;
+        prepareProcessor (processor, settings, numChannels, sampleRate);
+        processRange (processor, input, 0, input.getNumSamples(), settings.blockSize);
+        processor.releaseResources();
+
+        result.serialSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - t0);
+
+        double maxError = 0.0, sumSquares = 0.0;
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* serial = input.getReadPointer (ch);
+            const auto* chunked = output.getReadPointer (ch);
+
+            for (int i = 0; i < input.getNumSamples(); ++i)
+            {
+                const auto error = (double) chunked[i] - (double) serial[i];
+                maxError = juce::jmax (maxError, std::abs (error));
+                sumSquares += error * error;
+            }
+        }
+
+        const auto numSamples = juce::jmax (1.0, (double) numChannels * input.getNumSamples());
+        result.maxErrorDb = juce::Decibels::gainToDecibels ((float) maxError, -200.0f);
+        result.rmsErrorDb = juce::Decibels::gainToDecibels ((float) std::sqrt (sumSquares / numSamples), -200.0f);
+    }
+
+    juce::String write()
+    {
+        result.output.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream (result.output.createOutputStream());
+        if (stream == nullptr)
+            return "could not create output";
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate,
+                                                                               (unsigned int) numChannels, 24, {}, 0));
+        if (writer == nullptr)
+            return "could not create wav writer";
+        stream.release(); //writer owns the stream now
+
+        writer->writeFromAudioSampleBuffer (output, 0, output.getNumSamples());
+        return {};
+    }
+
+    const RenderSettings& settings;
+    RenderResult& result;
+
+    int numChannels {0};
+    double sampleRate {44100.0};
+    juce::AudioBuffer<float> input, output;
+    std::vector<Chunk> chunks;
+};
+
+
+//==============================================================================
+static void printUsage()
+{
+    std::cout << "usage: NeuralScreamerRender [options] <input.wav>...\n"
+                 "  --drive=<0..1>        drive knob (default 0.5)\n"
+                 "  --volume=<0..1.5>     level knob (default 1.0)\n"
+                 "  --tone=<20..20000>    tone cutoff in Hz (default 20000)\n"
+                 "  --model=<ts9|mini>    model to render with (default ts9)\n"
+                 "  --block=<samples>     block size handed to processBlock (default 4096)\n"
+                 "  --threads=<n>         worker threads (default: all cores)\n"
+                 "  --channel-threads=<n> extra threads per file for its channels (default 0)\n"
+                 "  --chunks              split each file into chunks rendered on all threads at once\n"
+                 "  --chunk-seconds=<s>   chunk length (default: an equal share per thread)\n"
+                 "  --warmup=<s>          input each chunk is warmed up on and discards (default 0.5)\n"
+                 "  --crossfade=<s>       crossfade between chunks (default 0.01)\n"
+                 "  --verify              also render serially and report the difference\n"
+                 "  --out=<dir>           output directory (default: next to each input)\n";
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit; //APVTS needs a message manager, nothing is ever shown
+
+    juce::ArgumentList args (argc, argv);
+    if (args.size() == 0 || args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    RenderSettings settings;
+    auto option = [&args] (const juce::String& name, const juce::String& fallback)
+    {
+        auto value = args.getValueForOption (name);
+        return value.isEmpty() ? fallback : value;
+    };
+
+    settings.drive     = juce::jlimit (0.0f, 1.0f,  option ("--drive", "0.5").getFloatValue());
+    settings.volume    = juce::jlimit (0.0f, 1.5f,  option ("--volume", "1.0").getFloatValue());
+    settings.tone      = juce::jlimit (20.0f, 20000.0f, option ("--tone", "20000").getFloatValue());
+    settings.ts9       = option ("--model", "ts9").equalsIgnoreCase ("ts9");
+    settings.blockSize = juce::jmax (32, option ("--block", "4096").getIntValue());
+    settings.channelThreads = juce::jmax (0, option ("--channel-threads", "0").getIntValue());
+
+    settings.chunkSeconds     = juce::jmax (0.0, option ("--chunk-seconds", "0").getDoubleValue());
+    settings.chunked          = args.containsOption ("--chunks") || settings.chunkSeconds > 0.0;
+    settings.warmupSeconds    = juce::jmax (0.0, option ("--warmup", "0.5").getDoubleValue());
+    settings.crossfadeSeconds = juce::jmax (0.0001, option ("--crossfade", "0.01").getDoubleValue());
+    settings.verify           = args.containsOption ("--verify");
+
+    const auto numThreads = juce::jmax (1, option ("--threads", juce::String (juce::SystemStats::getNumCpus())).getIntValue());
+    const auto outDir = option ("--out", {});
+
+    //Everything that isn't an option is an input file
+    juce::Array<juce::File> inputs;
+    for (auto& arg : args.arguments)
+        if (! arg.isOption())
+            inputs.add (arg.resolveAsFile());
+
+    if (inputs.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    //Per-file settings only differ in where the render lands
+    std::vector<RenderSettings> fileSettings ((size_t) inputs.size(), settings);
+    std::vector<RenderResult> results ((size_t) inputs.size());
+
+    for (int i = 0; i < inputs.size(); ++i)
+    {
+        auto& s = fileSettings[(size_t) i];
+        s.outputDir = outDir.isNotEmpty() ? juce::File::getCurrentWorkingDirectory().getChildFile (outDir)
+                                          : inputs[i].getParentDirectory();
+        s.outputDir.createDirectory();
+    }
+
+    //Whole files in parallel, or one file at a time with its chunks in parallel
+    const auto poolThreads = settings.chunked ? numThreads : juce::jmin (numThreads, inputs.size());
+    juce::ThreadPool pool (juce::ThreadPoolOptions{}.withNumberOfThreads (poolThreads));
+    std::cout << "LSTM kernel: " << LSTMKernel::select().name << "\n";
+    const auto t0 = juce::Time::getHighResolutionTicks();
+
+    if (settings.chunked)
+    {
+        for (int i = 0; i < inputs.size(); ++i)
+            ChunkedRender (inputs[i], fileSettings[(size_t) i], results[(size_t) i]).run (pool);
+    }
+    else
+    {
+        for (int i = 0; i < inputs.size(); ++i)
+            pool.addJob (new RenderJob (inputs[i], fileSettings[(size_t) i], results[(size_t) i]), true);
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (20);
+    }
+
+    //the serial renders for verify aren't part of the time taken
+    auto wallSeconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - t0);
+    for (auto& r : results)
+        wallSeconds -= r.serialSeconds;
+
+    //Report
+    double totalAudio = 0.0;
+    int failures = 0;
+
+    for (auto& r : results)
+    {
+        if (r.error.isNotEmpty())
+        {
+            ++failures;
+            std::cout << r.input.getFileName() << ": FAILED (" << r.error << ")\n";
+            continue;
+        }
+
+        totalAudio += r.audioSeconds;
+        std::cout << r.input.getFileName() << " -> " << r.output.getFullPathName()
+                  << "  " << juce::String (r.audioSeconds, 2) << " s audio in "
+                  << juce::String (r.wallSeconds, 2) << " s  (" << juce::String (r.realtimeFactor(), 1) << "x realtime, "
+                  << juce::roundToInt (r.performance.networkShare() * 100.0f) << "% in the network)\n";
+
+        if (r.numChunks > 0)
+            std::cout << "    " << r.numChunks << " chunk(s) with " << juce::String (settings.warmupSeconds, 2) << " s warm-up";
+
+        if (r.serialSeconds > 0.0)
+            std::cout << ", serial render " << juce::String (r.serialSeconds, 2) << " s ("
+                      << juce::String (r.wallSeconds > 0.0 ? r.serialSeconds / r.wallSeconds : 0.0, 1) << "x faster), difference "
+                      << juce::String (r.maxErrorDb, 1) << " dB peak, " << juce::String (r.rmsErrorDb, 1) << " dB RMS";
+
+        if (r.numChunks > 0)
+            std::cout << "\n";
+    }
+
+    std::cout << "\n" << (inputs.size() - failures) << " file(s), " << juce::String (totalAudio, 2) << " s audio in "
+              << juce::String (wallSeconds, 2) << " s on " << pool.getNumThreads() << " thread(s)  ("
+              << juce::String (wallSeconds > 0.0 ? totalAudio / wallSeconds : 0.0, 1) << "x realtime aggregate)\n";
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+/*
+  ==============================================================================
+
+    ActivationFormulas.h
+    Body of the activation tiers, for any value type V with float's operators
+    and clamp(), nearest() and pow2(). Only meant to be included inside a
+    namespace: by Activations.h for float, and by LSTMKernelSimd.h again, so
+    that the templates are compiled for that file's instruction set.
+
+  ==============================================================================
+*/
+
+//------------------------------------------------------------------------------
+// accurate: exp (x) = 2^n exp (r) with |r| <= ln2 / 2 and exp (r) from Cephes'
+// polynomial, about 1 ulp. The clamp keeps 2^n a normal float.
+namespace ExpConstants
+{
+    static constexpr float minInput = -87.0f, maxInput = 88.0f;
+    static constexpr float log2e = 1.44269504088896341f;
+    static constexpr float ln2Hi = 0.693359375f, ln2Lo = -2.12194440e-4f;
+    static constexpr float p0 = 1.9875691500e-4f, p1 = 1.3981999507e-3f, p2 = 8.3334519073e-3f,
+                           p3 = 4.1665795894e-2f, p4 = 1.6666665459e-1f, p5 = 5.0000001201e-1f;
+}
+
+template <typename V>
+inline V polyExp (V x) noexcept
+{
+    using namespace ExpConstants;
+    x = clamp (x, minInput, maxInput);
+
+    const V n = nearest (x * log2e);
+    const V r = (x - n * ln2Hi) - n * ln2Lo;
+    const V p = ((((p0 * r + p1) * r + p2) * r + p3) * r + p4) * r + p5;
+
+    return (p * r * r + r + 1.0f) * pow2 (n);
+}
+
+//------------------------------------------------------------------------------
+// fast: tanh as its [7/6] Pade approximant, clamped where that reaches 1, and
+// sigmoid (x) = (1 + tanh (x / 2)) / 2. One division each.
+namespace PadeConstants
+{
+    static constexpr float maxInput = 4.97f;
+    static constexpr float n0 = 135135.0f, n1 = 17325.0f, n2 = 378.0f;
+    static constexpr float d0 = 135135.0f, d1 = 62370.0f, d2 = 3150.0f, d3 = 28.0f;
+}
+
+template <typename V>
+inline V tanhPade (V x) noexcept
+{
+    using namespace PadeConstants;
+    x = clamp (x, -maxInput, maxInput);
+
+    const V x2 = x * x;
+    const V num = x * (((x2 + n2) * x2 + n1) * x2 + n0);
+    const V den = ((d3 * x2 + d2) * x2 + d1) * x2 + d0;
+    return clamp (num / den, -1.0f, 1.0f);
+}
+
+//------------------------------------------------------------------------------
+/** sigmoid and tanh of one tier. exact only takes float. */
+template <ActivationAccuracy accuracy>
+struct Tier
+{
+    template <typename V>
+    static V sigmoid (V x) noexcept
+    {
+        if constexpr (accuracy == ActivationAccuracy::fast)
+            return 0.5f + 0.5f * tanhPade (0.5f * x);
+        else if constexpr (accuracy == ActivationAccuracy::accurate)
+            return 1.0f / (1.0f + polyExp (-x));
+        else
+            return 1.0f / (1.0f + std::exp (-x));
+    }
+
+    template <typename V>
+    static V tanh (V x) noexcept
+    {
+        if constexpr (accuracy == ActivationAccuracy::fast)
+            return tanhPade (x);
+        else if constexpr (accuracy == ActivationAccuracy::accurate)
+        {
+            const V e = polyExp (2.0f * x);
+            return (e - 1.0f) / (e + 1.0f);
+        }
+        else
+            return std::tanh (x);
+    }
+};
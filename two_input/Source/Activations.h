@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    Activations.h
+    Sigmoid and tanh for the recurrent cells, at a choice of accuracy
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+/**
+    How the LSTM and GRU cell updates evaluate their sigmoids and tanhs. At 64 units
+    an LSTM step takes 192 sigmoids and 128 tanhs per channel; std::exp and std::tanh
+    do them one at a time, the other tiers a whole SIMD register at once.
+*/
+enum class ActivationAccuracy
+{
+    exact,     //std::exp and std::tanh, bit-exact with the exported model (default)
+    accurate,  //polynomial exp, within 3e-7 of exact
+    fast       //clamped rational tanh, no exp, within 1e-4 of exact
+};
+
+inline const char* getActivationAccuracyName (ActivationAccuracy accuracy) noexcept
+{
+    switch (accuracy)
+    {
+        case ActivationAccuracy::accurate: return "accurate";
+        case ActivationAccuracy::fast:     return "fast";
+        case ActivationAccuracy::exact:    break;
+    }
+
+    return "exact";
+}
+
+
+/**
+    The formulas of each tier (ActivationFormulas.h), for float. LSTMKernelSimd.h
+    includes them again for its SIMD register wrapper, which provides the same
+    operators and clamp(), nearest() and pow2() for its lanes, so the portable kernel,
+    stepGeneric and every SIMD kernel evaluate exactly the same thing.
+*/
+namespace Activations
+{
+    inline float clamp (float x, float lo, float hi) noexcept { return std::min (std::max (x, lo), hi); }
+    inline float nearest (float x) noexcept                   { return std::nearbyint (x); }
+
+    /** 2^n for a whole number n in [-126, 127]. */
+    inline float pow2 (float n) noexcept
+    {
+        const auto bits = ((std::int32_t) n + 127) << 23;
+        float result;
+        std::memcpy (&result, &bits, sizeof (result));
+        return result;
+    }
+
+    #include "ActivationFormulas.h"
+
+    /** Calls f with accuracy as a std::integral_constant, so a whole step can be
+        instantiated per tier and picked with one branch.
+    */
+    template <typename Function>
+    inline void dispatch (ActivationAccuracy accuracy, Function&& f)
+    {
+        using A = ActivationAccuracy;
+
+        switch (accuracy)
+        {
+            case A::accurate: f (std::integral_constant<A, A::accurate>{}); return;
+            case A::fast:     f (std::integral_constant<A, A::fast>{}); return;
+            case A::exact:    break;
+        }
+
+        f (std::integral_constant<A, A::exact>{});
+    }
+}
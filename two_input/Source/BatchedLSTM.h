@@ -0,0 +1,679 @@
+/*
+  ==============================================================================
+
+    BatchedLSTM.h
+    LSTM or GRU + Dense inference that advances several channels per step
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "LSTMKernel.h"
+#include "OutputStage.h"
+#include "SubBlockParameters.h"
+#include "WorkerPool.h"
+
+
+/** Block-mode working memory for BatchedRNN::processBlock. It holds nothing
+    between calls, so one Scratch can serve every batch of a model in turn.
+*/
+template <int hiddenSize, int numLanes>
+struct RNNScratch
+{
+    static constexpr int maxTileSize = 32;
+
+    /** Not realtime safe. */
+    void prepare (int maxBlockSize)
+    {
+        tileSize = maxBlockSize < maxTileSize ? (maxBlockSize > 0 ? maxBlockSize : 1) : maxTileSize;
+        projection.assign ((size_t) (tileSize * numLanes * 4 * hiddenSize), 0.0f);
+        history.assign ((size_t) (tileSize * numLanes * hiddenSize), 0.0f);
+    }
+
+    int tileSize {0};
+    std::vector<float> projection, history;
+};
+
+
+/**
+    Recurrent state for numLanes channels running through one set of LSTMWeights
+    or GRUWeights.
+
+    Channels are the lanes of each step: every weight row is loaded once per sample
+    and applied to all lanes while it is still in cache, instead of once per channel.
+    The weights aren't owned and never written, so every batch of every plugin
+    instance can point at the same copy (see WeightStore); all a batch keeps of
+    its own is the h (and for an LSTM, c) state of its lanes.
+
+    Both weight types have gate rows 4 * hiddenSize long (see GRUWeights), so the
+    input projection and Dense layer are the same code for either.
+*/
+template <typename WeightsType, int numLanes>
+class BatchedRNN
+{
+public:
+    using Weights   = WeightsType;
+    using Quantized = QuantizedWeights<Weights>;
+    static constexpr int inSize     = Weights::numInputs;
+    static constexpr int hiddenSize = Weights::numHidden;
+    using Scratch   = RNNScratch<hiddenSize, numLanes>;
+    static constexpr int lanes = numLanes;
+
+    void setWeights (const Weights* newWeights)
+    {
+        weights = newWeights;
+        conditioningValid = false;
+    }
+
+    /** Reads the recurrent and Dense weights from quantized at the given precision.
+        Pass nullptr (or WeightPrecision::full) to go back to the fp32 weights.
+    */
+    void setQuantizedWeights (const Quantized* newQuantized, WeightPrecision newPrecision) noexcept
+    {
+        quantized = newQuantized;
+        precision = quantized != nullptr ? newPrecision : WeightPrecision::full;
+    }
+
+    void setKernel (const LSTMKernel::Kernel& newKernel) noexcept { kernel = &newKernel; }
+
+    void setActivationAccuracy (ActivationAccuracy newAccuracy) noexcept { activations = newAccuracy; }
+
+    void reset() noexcept
+    {
+        for (int l = 0; l < numLanes; ++l)
+            for (int j = 0; j < hiddenSize; ++j)
+                h[l][j] = c[l][j] = 0.0f;
+    }
+
+    /** Advances every lane by one sample. */
+    void forward (const float (&input)[numLanes][inSize], float (&output)[numLanes]) noexcept
+    {
+        constexpr int G = Weights::numGates;
+        const auto& w = *weights;
+        alignas (64) float gates[numLanes][G];
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int r = 0; r < G; ++r)
+                gates[l][r] = w.bias[r];
+
+        for (int k = 0; k < inSize; ++k)
+            for (int l = 0; l < numLanes; ++l)
+                accumulate (gates[l], w.inputKernel[k], input[l][k]);
+
+        recurrentStep (gates);
+
+        for (int l = 0; l < numLanes; ++l)
+            output[l] = dense (h[l]);
+    }
+
+    //==============================================================================
+    /** For conditioned models: inputs 1..inSize-1 are knobs that stay put for a
+        whole block, so their share of the input projection is folded into the
+        bias here. Only recomputed when the values change, so it is cheap to call
+        every block.
+    */
+    void setConditioning (const float (&conditioning)[inSize - 1]) noexcept
+    {
+        if (conditioningValid && std::equal (conditioning, conditioning + inSize - 1, currentConditioning))
+            return;
+
+        const auto& w = *weights;
+        for (int r = 0; r < Weights::numGates; ++r)
+            conditionedBias[r] = w.bias[r];
+
+        for (int k = 1; k < inSize; ++k)
+            accumulate (conditionedBias, w.inputKernel[k], conditioning[k - 1]);
+
+        std::copy (conditioning, conditioning + inSize - 1, currentConditioning);
+        conditioningValid = true;
+    }
+
+    /** Like forward() but only the audio input column is applied per sample,
+        on top of the bias from setConditioning().
+    */
+    void forwardConditioned (const float (&audio)[numLanes], float (&output)[numLanes]) noexcept
+    {
+        jassert (conditioningValid);
+        const float* audioColumn = weights->inputKernel[0];
+        alignas (64) float gates[numLanes][Weights::numGates];
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int r = 0; r < Weights::numGates; ++r)
+                gates[l][r] = conditionedBias[r] + audioColumn[r] * audio[l];
+
+        recurrentStep (gates);
+
+        for (int l = 0; l < numLanes; ++l)
+            output[l] = dense (h[l]);
+    }
+
+    //==============================================================================
+    /** Block-mode forward for conditioned models, in place or out of place.
+
+        The input projection doesn't depend on the recurrent state, so it is
+        computed for a whole tile of samples in one vectorised pass before the
+        serial loop, which is left with just the hidden-to-hidden matvec. The
+        Dense layer then runs as one batched pass over the tile's hidden states,
+        each sample going straight through output (if there is one) with the
+        given settings and the lanes as its channels firstChannel onwards.
+        Lanes from numActiveLanes up are fed silence and their output dropped.
+    */
+    void processBlock (const float* const* in, float* const* out, int numActiveLanes, int numSamples,
+                       const float (&conditioning)[inSize - 1], Scratch& scratch, OutputStage* output = nullptr,
+                       const OutputStage::Settings& outputSettings = {}, int firstChannel = 0) noexcept
+    {
+        jassert (! scratch.projection.empty());
+        setConditioning (conditioning);
+
+        constexpr int G = Weights::numGates;
+        const float* audioColumn = weights->inputKernel[0];
+        const auto tileSize = scratch.tileSize;
+
+        //the filter state is written back once, at the end of the run
+        OutputStage::LaneState<numLanes> filter;
+        if (output != nullptr)
+            filter = output->load<numLanes> (firstChannel);
+
+        for (int start = 0; start < numSamples; start += tileSize)
+        {
+            const auto len = numSamples - start < tileSize ? numSamples - start : tileSize;
+            auto* proj = reinterpret_cast<float (*)[G]> (scratch.projection.data());
+            auto* hist = reinterpret_cast<float (*)[hiddenSize]> (scratch.history.data());
+
+            //input projection for the whole tile
+            for (int s = 0; s < len; ++s)
+                for (int l = 0; l < numLanes; ++l)
+                {
+                    const auto x = l < numActiveLanes ? in[l][start + s] : 0.0f;
+                    float* g = proj[s * numLanes + l];
+
+                    for (int r = 0; r < G; ++r)
+                        g[r] = conditionedBias[r] + audioColumn[r] * x;
+                }
+
+            //serial part: recurrent matvec and state update only
+            for (int s = 0; s < len; ++s)
+            {
+                recurrentStep (proj + s * numLanes);
+
+                for (int l = 0; l < numLanes; ++l)
+                    std::copy (h[l], h[l] + hiddenSize, hist[s * numLanes + l]);
+            }
+
+            //batched Dense(hidden -> 1) over the tile
+            if (output == nullptr)
+            {
+                for (int l = 0; l < numActiveLanes; ++l)
+                    for (int s = 0; s < len; ++s)
+                        out[l][start + s] = dense (hist[s * numLanes + l]);
+
+                continue;
+            }
+
+            //fused with the level and tone, every lane of a sample at once
+            for (int s = 0; s < len; ++s)
+            {
+                float y[numLanes];
+                for (int l = 0; l < numLanes; ++l)
+                    y[l] = dense (hist[s * numLanes + l]);
+
+                OutputStage::processLanes (y, filter, outputSettings, start + s);
+
+                for (int l = 0; l < numActiveLanes; ++l)
+                    out[l][start + s] = y[l];
+            }
+        }
+
+        if (output != nullptr)
+            output->store (filter, firstChannel);
+    }
+
+    /** Dense output for a lane's current state (before any gain), i.e. its last output sample. */
+    float currentOutput (int lane) const noexcept { return dense (h[lane]); }
+
+    /** Takes over one lane's state from a batch of another width. */
+    template <int otherLanes>
+    void copyLane (int lane, const BatchedRNN<Weights, otherLanes>& source, int sourceLane) noexcept
+    {
+        std::copy (source.h[sourceLane], source.h[sourceLane] + hiddenSize, h[lane]);
+        std::copy (source.c[sourceLane], source.c[sourceLane] + hiddenSize, c[lane]);
+    }
+
+private:
+    template <typename, int> friend class BatchedRNN;
+
+    /** Adds the recurrent matvec into g (one gate row per lane) and advances the state. */
+    void recurrentStep (float (*g)[4 * hiddenSize]) noexcept
+    {
+        LSTMKernel::step<Weights, numLanes> (*kernel, precision, activations, *weights, quantized, g, h, c);
+    }
+
+    static void accumulate (float* acc, const float* row, float x) noexcept
+    {
+        for (int r = 0; r < 4 * hiddenSize; ++r)
+            acc[r] += row[r] * x;
+    }
+
+    float dense (const float* hidden) const noexcept
+    {
+        auto y = weights->denseBias;
+
+        if (precision == WeightPrecision::half)
+        {
+            for (int j = 0; j < hiddenSize; ++j)
+                y += halfToFloat (quantized->denseHalf[j]) * hidden[j];
+        }
+        else if (precision == WeightPrecision::int8)
+        {
+            auto sum = 0.0f;
+            for (int j = 0; j < hiddenSize; ++j)
+                sum += (float) quantized->denseInt8[j] * hidden[j];
+
+            y += sum * quantized->denseScale;
+        }
+        else
+        {
+            for (int j = 0; j < hiddenSize; ++j)
+                y += weights->denseKernel[j] * hidden[j];
+        }
+
+        return y;
+    }
+
+    const Weights* weights {nullptr};
+    const Quantized* quantized {nullptr};
+    WeightPrecision precision {WeightPrecision::full};
+    ActivationAccuracy activations {ActivationAccuracy::exact};
+    const LSTMKernel::Kernel* kernel { &LSTMKernel::select() };
+
+    alignas (64) float h[numLanes][hiddenSize] {};
+    alignas (64) float c[numLanes][hiddenSize] {};
+
+    alignas (64) float conditionedBias[4 * hiddenSize] {};
+    float currentConditioning[inSize > 1 ? inSize - 1 : 1] {};
+    bool conditioningValid {false};
+};
+
+
+
+/**
+    A drive-conditioned model (inputs: audio sample, drive knob) for any number of
+    channels, with LSTMWeights or GRUWeights. Channels are grouped into BatchedRNNs
+    of lanesPerBatch lanes; the groups are sized in prepare() so processBlock never
+    indexes past them.
+
+    With a WorkerPool (setWorkerPool()), calls that allow it run each channel in a
+    single lane batch of its own instead, spread over the pool's threads: one task
+    per channel that goes through every run of the block. Lanes of a batch are
+    stepped one after another, so that's the only way the channels of one block
+    can run at the same time. Other calls stay on the calling thread, in pairs;
+    the state moves across whenever the layout changes.
+
+    A batch whose input has stayed below the idle threshold for the hold time, and
+    whose output has stayed within settleTolerance over that whole time, goes idle:
+    inference is skipped and the settled output is written instead. Its state is
+    left frozen at that settled point, so when signal comes back the network
+    carries on from a state whose output is within settleTolerance of where a full
+    computation of the silence would have got it, without a click or re-warm-up.
+*/
+template <typename WeightsType>
+class NeuralModel
+{
+public:
+    static constexpr int inSize = 2;
+    static constexpr int lanesPerBatch = 2;
+
+    using Weights   = WeightsType;
+    using Quantized = QuantizedWeights<Weights>;
+    using Batch     = BatchedRNN<Weights, lanesPerBatch>;
+    using SoloBatch = BatchedRNN<Weights, 1>;
+    static constexpr int hiddenSize = Weights::numHidden;
+    static_assert (Weights::numInputs == inSize, "audio and drive in");
+
+    /** Cheap when the weights don't change, so it can be called every block. */
+    void setWeights (const Weights* newWeights) noexcept
+    {
+        if (newWeights == weights)
+            return;
+
+        weights = newWeights;
+        forEachBatch ([this] (auto& b) { b.setWeights (weights); });
+
+        //the settled outputs belong to the old weights
+        deactivateIdle();
+    }
+
+    bool hasWeights() const noexcept { return weights != nullptr; }
+
+    /** Reduced precision copies of the current weights, used whenever the precision
+        isn't WeightPrecision::full. Until they arrive (nullptr) the fp32 weights are used.
+        Cheap when nothing changes, so it can be called every block.
+    */
+    void setQuantizedWeights (const Quantized* newQuantized) noexcept
+    {
+        if (newQuantized == quantized)
+            return;
+
+        quantized = newQuantized;
+        updatePrecision();
+    }
+
+    /** Storage the recurrent and Dense weights are read from, see WeightPrecision. */
+    void setPrecision (WeightPrecision newPrecision) noexcept
+    {
+        if (newPrecision == precision)
+            return;
+
+        precision = newPrecision;
+        updatePrecision();
+    }
+
+    WeightPrecision getPrecision() const noexcept { return precision; }
+
+    /** How the cells evaluate their activations, see ActivationAccuracy. Cheap when it
+        doesn't change, so it can be called every block.
+    */
+    void setActivationAccuracy (ActivationAccuracy newAccuracy) noexcept
+    {
+        if (newAccuracy == activations)
+            return;
+
+        activations = newAccuracy;
+        updateActivations();
+    }
+
+    ActivationAccuracy getActivationAccuracy() const noexcept { return activations; }
+
+    /** Instruction set to run the recurrent step with, see LSTMKernel::select(). */
+    void setKernel (const LSTMKernel::Kernel& newKernel)
+    {
+        kernel = &newKernel;
+        forEachBatch ([&newKernel] (auto& b) { b.setKernel (newKernel); });
+    }
+
+    /** Input peak below which a channel counts as silent, and how long every channel of a
+        batch has to stay silent before it may go idle. The output is watched over the same
+        span, so how settled it has to be doesn't depend on the block size. A holdSamples
+        of 0 disables idling.
+    */
+    void setIdleDetection (float threshold, int holdSamples) noexcept
+    {
+        idleThreshold = threshold;
+        idleHoldSamples = holdSamples;
+    }
+
+    /** Lets process() calls that ask for it run their channels on pool's threads as
+        well as the calling one; nullptr keeps everything on the calling thread.
+        Call before prepare(), not realtime safe.
+    */
+    void setWorkerPool (WorkerPool* newPool) noexcept
+    {
+        pool = newPool;
+    }
+
+    /** Allocates state and scratch for numChannels. Not realtime safe. */
+    void prepare (int numChannels, int maxBlockSize)
+    {
+        batches.resize ((size_t) ((numChannels + lanesPerBatch - 1) / lanesPerBatch));
+        idle.resize (batches.size());
+        preparedChannels = numChannels;
+        scratch.prepare (maxBlockSize);
+
+        //a batch and scratch per channel, only needed with a pool
+        const auto numSolo = (size_t) (pool != nullptr ? numChannels : 0);
+        solo.resize (numSolo);
+        soloIdle.resize (numSolo);
+        soloScratch.resize (numSolo);
+        for (auto& s : soloScratch)
+            s.prepare (maxBlockSize);
+
+        soloActive = false;
+        forEachBatch ([this] (auto& b) { b.setWeights (weights); });
+
+        setKernel (*kernel);
+        updatePrecision();
+        updateActivations();
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        forEachBatch ([] (auto& b) { b.reset(); });
+
+        for (auto& state : idle)
+            state = {};
+
+        for (auto& state : soloIdle)
+            state = {};
+    }
+
+    int getNumChannels() const noexcept { return preparedChannels; }
+
+    /** Runs the network in place over each channel, one run of the block after the
+        other (see SubBlockRun), each output sample going straight through output with
+        the run's settings if there is one (see OutputStage).
+
+        parallel lets the channels run on the worker pool, if there is one, which is
+        handed the whole block at once. Switching between that and the pairs moves
+        the state across, so it's worth deciding on per block rather than per call.
+    */
+    void process (float* const* channels, int numChannels, const SubBlockRun* runs, int numRuns,
+                  OutputStage* output = nullptr, bool parallel = true) noexcept
+    {
+        numChannels = numChannels < preparedChannels ? numChannels : preparedChannels;
+
+        if (pool != nullptr && numChannels > 1 && parallel)
+        {
+            useSoloBatches (true);
+
+            auto task = [&] (int ch)
+            {
+                for (int r = 0; r < numRuns; ++r)
+                {
+                    float* lane = channels[ch] + runs[r].start;
+                    processBatch (solo[(size_t) ch], soloIdle[(size_t) ch], soloScratch[(size_t) ch],
+                                  &lane, 1, runs[r], output, ch);
+                }
+            };
+
+            pool->run (numChannels, task);
+            return;
+        }
+
+        useSoloBatches (false);
+
+        for (int r = 0; r < numRuns; ++r)
+        {
+            for (int b = 0; b * lanesPerBatch < numChannels; ++b)
+            {
+                const auto first = b * lanesPerBatch;
+                const auto used = numChannels - first < lanesPerBatch ? numChannels - first : lanesPerBatch;
+
+                float* lanes[lanesPerBatch] {};
+                for (int l = 0; l < used; ++l)
+                    lanes[l] = channels[first + l] + runs[r].start;
+
+                processBatch (batches[(size_t) b], idle[(size_t) b], scratch, lanes, used, runs[r], output, first);
+            }
+        }
+    }
+
+    /** A single run of numSamples at drive, with output's current settings. */
+    void process (float* const* channels, int numChannels, int numSamples, float drive,
+                  OutputStage* output = nullptr, bool parallel = true) noexcept
+    {
+        const SubBlockRun run { 0, numSamples, drive, output != nullptr ? output->getSettings() : OutputStage::Settings {} };
+        process (channels, numChannels, &run, 1, output, parallel);
+    }
+
+    /** True if at least one batch is skipping inference right now. */
+    bool isAnyIdle() const noexcept
+    {
+        auto isActive = [] (const IdleState& s) { return s.active; };
+        return std::any_of (idle.begin(), idle.end(), isActive) || std::any_of (soloIdle.begin(), soloIdle.end(), isActive);
+    }
+
+private:
+    struct IdleState
+    {
+        int windowSamples {0};              //silent samples watched so far, 0 before the first
+        float lowest[lanesPerBatch] {};     //range of the output over them
+        float highest[lanesPerBatch] {};
+        bool active {false};
+        float drive {0.0f};
+    };
+
+    /** One run of a batch of used channels, starting at channel first, idling if it can. */
+    template <typename BatchType>
+    void processBatch (BatchType& batch, IdleState& state, typename BatchType::Scratch& batchScratch, float* const* lanes,
+                       int used, const SubBlockRun& run, OutputStage* output, int first) noexcept
+    {
+        constexpr int numLanes = BatchType::lanes;
+        const auto numSamples = run.length;
+        const auto drive = run.drive;
+
+        const auto silent = idleHoldSamples > 0 && isSilent (lanes, used, numSamples);
+
+        //still idle: the settled output only depends on the drive it settled at
+        if (state.active && silent && drive == state.drive)
+        {
+            for (int l = 0; l < used; ++l)
+                std::fill (lanes[l], lanes[l] + numSamples, batch.currentOutput (l));
+
+            if (output != nullptr)
+                output->process (lanes, run.output, first, used, numSamples);
+
+            return;
+        }
+
+        state.active = false;
+
+        //a window opens with the output the silence started from
+        if (! silent)
+            state.windowSamples = 0;
+        else if (state.windowSamples == 0)
+            for (int l = 0; l < numLanes; ++l)
+                state.lowest[l] = state.highest[l] = batch.currentOutput (l);
+
+        //drive is constant for the run, it is folded into the gate bias
+        const float conditioning[inSize - 1] { drive };
+        batch.processBlock (lanes, lanes, used, numSamples, conditioning, batchScratch, output, run.output, first);
+
+        if (! silent)
+            return;
+
+        auto settled = true;
+        for (int l = 0; l < numLanes; ++l)
+        {
+            const auto y = batch.currentOutput (l);
+            state.lowest[l]  = std::min (state.lowest[l], y);
+            state.highest[l] = std::max (state.highest[l], y);
+            settled = settled && state.highest[l] - state.lowest[l] < settleTolerance;
+        }
+
+        //go idle once a whole hold time of silence kept the output in range, otherwise
+        //watch the next one; the range is sampled at the end of each run
+        state.windowSamples += numSamples;
+        if (state.windowSamples >= idleHoldSamples)
+        {
+            state.active = settled;
+            state.drive = drive;
+            state.windowSamples = 0;
+        }
+    }
+
+    /** Moves the state to the single lane batches or back to the pairs. */
+    void useSoloBatches (bool wanted) noexcept
+    {
+        if (wanted == soloActive)
+            return;
+
+        for (int ch = 0; ch < (int) solo.size(); ++ch)
+        {
+            auto& pair = batches[(size_t) (ch / lanesPerBatch)];
+
+            if (wanted)
+                solo[(size_t) ch].copyLane (0, pair, ch % lanesPerBatch);
+            else
+                pair.copyLane (ch % lanesPerBatch, solo[(size_t) ch], 0);
+        }
+
+        soloActive = wanted;
+        deactivateIdle();
+    }
+
+    template <typename Function>
+    void forEachBatch (Function&& f)
+    {
+        for (auto& b : batches)
+            f (b);
+
+        for (auto& b : solo)
+            f (b);
+    }
+
+    /** Also starts the windows over: what they saw came from other weights or batches. */
+    void deactivateIdle() noexcept
+    {
+        for (auto& state : idle)
+        {
+            state.active = false;
+            state.windowSamples = 0;
+        }
+
+        for (auto& state : soloIdle)
+        {
+            state.active = false;
+            state.windowSamples = 0;
+        }
+    }
+
+    void updatePrecision() noexcept
+    {
+        forEachBatch ([this] (auto& b) { b.setQuantizedWeights (quantized, precision); });
+
+        //the settled outputs were computed with the old weights
+        deactivateIdle();
+    }
+
+    void updateActivations() noexcept
+    {
+        forEachBatch ([this] (auto& b) { b.setActivationAccuracy (activations); });
+        deactivateIdle();
+    }
+
+    bool isSilent (const float* const* channels, int numChannels, int numSamples) const noexcept
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int n = 0; n < numSamples; ++n)
+                if (std::abs (channels[ch][n]) >= idleThreshold)
+                    return false;
+
+        return true;
+    }
+
+    //range of the output over one hold time below which it counts as settled (about -100 dB)
+    static constexpr float settleTolerance = 1.0e-5f;
+
+    const Weights* weights {nullptr};
+    const Quantized* quantized {nullptr};
+    WeightPrecision precision {WeightPrecision::full};
+    ActivationAccuracy activations {ActivationAccuracy::exact};
+    const LSTMKernel::Kernel* kernel { &LSTMKernel::select() };
+    std::vector<Batch> batches;
+    std::vector<IdleState> idle;
+    float idleThreshold {0.0f};
+    int idleHoldSamples {0};
+    typename Batch::Scratch scratch; //shared by the batches, they run one after another
+    int preparedChannels {0};
+
+    WorkerPool* pool {nullptr};
+    std::vector<SoloBatch> solo;
+    std::vector<IdleState> soloIdle;
+    std::vector<typename SoloBatch::Scratch> soloScratch; //one each, they run at the same time
+    bool soloActive {false};
+};
@@ -228,3 +228,27 @@ void CustomToggleButton::mouseExit(const juce::MouseEvent & event)
     repaint();
 }
 
+
+
+
+void PerformanceOverlay::timerCallback()
+{
+    snapshot = monitor.getSnapshot();
+    repaint();
+}
+
+
+void PerformanceOverlay::paint(juce::Graphics& g)
+{
+    auto percent = [] (float x) { return juce::String(juce::roundToInt(x * 100.0f)) + "%"; };
+    
+    juce::String text;
+    text << kernelName << "   CPU " << percent(snapshot.recentLoad) << " (peak " << percent(snapshot.recentPeakLoad) << ")"
+         << "   NN " << percent(snapshot.networkShare())
+         << "   overruns " << juce::String(snapshot.numOverruns);
+    
+    //turns red once a block has missed its deadline
+    g.setColour(snapshot.numOverruns > 0 ? juce::Colours::red : juce::Colours::white.withAlpha(0.6f));
+    g.setFont(juce::FontOptions(getHeight() * 0.8f));
+    g.drawText(text, getLocalBounds(), juce::Justification::centredRight);
+}
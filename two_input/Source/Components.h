@@ -10,6 +10,7 @@
 
 #pragma once
 #include <JuceHeader.h>
+#include "PerformanceMonitor.h"
 
 
 class CustomLNF : public juce::LookAndFeel_V4
@@ -106,3 +107,27 @@ private:
     bool mouseOver {false};
     juce::DropShadower shadow;
 };
+
+
+
+/** Small CPU readout: the recurrent kernel in use, load against the block deadline, network
+    share of the DSP time, overruns.
+*/
+class PerformanceOverlay : public juce::Component, private juce::Timer
+{
+public:
+    PerformanceOverlay(PerformanceMonitor& m, const juce::String& kernel) : monitor(m), kernelName(kernel)
+    {
+        setInterceptsMouseClicks(false, false);
+        startTimerHz(5);
+    }
+    
+    void paint(juce::Graphics& g) override;
+    
+private:
+    void timerCallback() override;
+    
+    PerformanceMonitor& monitor;
+    PerformanceMonitor::Snapshot snapshot;
+    juce::String kernelName;
+};
@@ -0,0 +1,128 @@
+/*
+  ==============================================================================
+
+    GRUWeights.h
+    Read-only weights for the GRU + Dense networks exported by model.py --cell gru
+
+  ==============================================================================
+*/
+
+#pragma once
+#include "LSTMWeights.h"
+
+
+/**
+    Weights of a GRU(inSize -> hiddenSize) followed by a Dense(hiddenSize -> 1), as
+    Keras trains it (reset_after, the TF2 default):
+
+        z = sigmoid (x Wz + h Uz + bz)
+        r = sigmoid (x Wr + h Ur + br)
+        n = tanh (x Wn + bn + r * (h Un + rbn))
+        h = n + z * (h - n)
+
+    Three gates per unit instead of the LSTM's four, so the recurrent matvec, which
+    is nearly all of the work, is a quarter smaller at the same width.
+
+    The recurrent columns are blocked like LSTMWeights', [ z(u0..u7) r(u0..u7) n(u0..u7) ]
+    per block of unitsPerBlock units, with the n column only holding the recurrent
+    half of the candidate (h Un + rbn, which r scales). A gate row is still 4 * hiddenSize
+    long: its last hiddenSize entries hold the input half of the candidate (x Wn + bn),
+    which no recurrent weight feeds. That keeps the input projection, conditioning and
+    scratch in BatchedRNN the same for both cell types. The input and recurrent biases
+    of z and r are summed into one.
+*/
+template <int inSize, int hiddenSize>
+struct GRUWeights
+{
+    static constexpr CellType cellType = CellType::gru;
+    static constexpr int numInputs = inSize;
+    static constexpr int numHidden = hiddenSize;
+    static constexpr int numGates  = 4 * hiddenSize; //gate row length, see above
+
+    static constexpr int unitsPerBlock = hiddenSize % 8 == 0 ? 8 : hiddenSize;
+    static constexpr int numBlocks     = hiddenSize / unitsPerBlock;
+    static constexpr int gatesPerBlock = 3 * unitsPerBlock;
+
+    /** Gate columns the recurrent kernel feeds: z, r and n of every unit. */
+    static constexpr int numRecurrentColumns = 3 * hiddenSize;
+
+    /** Where gate z (0), r (1), n (2) or the candidate's input half (3) of a unit lives. */
+    static constexpr int column (int gate, int unit) noexcept
+    {
+        return gate == 3 ? numRecurrentColumns + unit
+                         : (unit / unitsPerBlock) * gatesPerBlock + gate * unitsPerBlock + unit % unitsPerBlock;
+    }
+
+    alignas (64) float inputKernel[inSize][numGates] {};
+    alignas (64) float recurrentKernel[numBlocks][hiddenSize][gatesPerBlock] {};
+    alignas (64) float bias[numGates] {};
+    alignas (64) float denseKernel[hiddenSize] {};
+    float denseBias {0.0f};
+
+    /** Loads the binary format written by Python/export_binary.py, see NswHeader. */
+    bool loadBinary (const void* data, size_t size) { return loadNswBinary (*this, data, size); }
+
+    /** Loads an RTNeural-style export. Returns false if the architecture doesn't match,
+        including GRUs trained without reset_after (a single bias row).
+    */
+    bool loadJson (const nlohmann::json& modelJson)
+    {
+        const auto& layers = modelJson.at ("layers");
+        if (layers.size() != 2 || layers[0].at ("type") != "gru" || layers[1].at ("type") != "dense")
+            return false;
+
+        const auto& gru = layers[0].at ("weights");
+        const auto& dense = layers[1].at ("weights");
+        constexpr auto keras = (size_t) (3 * hiddenSize);
+
+        if (gru.size() != 3 || gru[0].size() != (size_t) inSize || gru[1].size() != (size_t) hiddenSize
+             || gru[2].size() != 2 || gru[2][0].size() != keras)
+            return false;
+
+        if (dense.size() != 2 || dense[0].size() != (size_t) hiddenSize || dense[1].size() != 1)
+            return false;
+
+        const auto& inputBias = gru[2][0];
+        const auto& recurrentBias = gru[2][1];
+
+        for (int unit = 0; unit < hiddenSize; ++unit)
+        {
+            //z and r: both halves straight into the block, biases summed
+            for (int gate = 0; gate < 2; ++gate)
+            {
+                const auto src = gate * hiddenSize + unit;
+                const auto dst = column (gate, unit);
+
+                for (int k = 0; k < inSize; ++k)
+                    inputKernel[k][dst] = gru[0][k][src].get<float>();
+
+                bias[dst] = inputBias[src].get<float>() + recurrentBias[src].get<float>();
+            }
+
+            //candidate: recurrent half in the block, input half after the blocks
+            const auto src = 2 * hiddenSize + unit;
+            const auto recurrentDst = column (2, unit);
+            const auto inputDst = column (3, unit);
+
+            for (int k = 0; k < inSize; ++k)
+                inputKernel[k][inputDst] = gru[0][k][src].get<float>();
+
+            bias[recurrentDst] = recurrentBias[src].get<float>();
+            bias[inputDst] = inputBias[src].get<float>();
+
+            for (int gate = 0; gate < 3; ++gate)
+            {
+                const auto dst = column (gate, unit);
+
+                for (int k = 0; k < hiddenSize; ++k)
+                    recurrentKernel[dst / gatesPerBlock][k][dst % gatesPerBlock] = gru[1][k][gate * hiddenSize + unit].get<float>();
+            }
+        }
+
+        for (int k = 0; k < hiddenSize; ++k)
+            denseKernel[k] = dense[0][k][0].get<float>();
+
+        denseBias = dense[1][0].get<float>();
+        return true;
+    }
+};
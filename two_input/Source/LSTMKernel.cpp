@@ -0,0 +1,75 @@
+/*
+  ==============================================================================
+
+    LSTMKernel.cpp
+    Portable recurrent kernel and runtime kernel selection
+
+  ==============================================================================
+*/
+
+#include "LSTMKernel.h"
+
+namespace
+{
+    #define LSTMKERNEL_PORTABLE 1
+    #include "LSTMKernelSimd.h"
+    #undef LSTMKERNEL_PORTABLE
+
+    const LSTMKernel::Kernel portableKernel { "portable", LSTMKernel::stepPortable, LSTMKernel::stepPortable, LSTMKernel::stepPortable,
+                                                          LSTMKernel::stepPortableGRU, LSTMKernel::stepPortableGRU, LSTMKernel::stepPortableGRU };
+   #if JUCE_INTEL
+    const LSTMKernel::Kernel sse2Kernel     { "sse2",     LSTMKernel::stepSSE2, LSTMKernel::stepSSE2, LSTMKernel::stepSSE2,
+                                                          LSTMKernel::stepSSE2GRU, LSTMKernel::stepSSE2GRU, LSTMKernel::stepSSE2GRU };
+    const LSTMKernel::Kernel avx2Kernel     { "avx2",     LSTMKernel::stepAVX2, LSTMKernel::stepAVX2, LSTMKernel::stepAVX2,
+                                                          LSTMKernel::stepAVX2GRU, LSTMKernel::stepAVX2GRU, LSTMKernel::stepAVX2GRU };
+    const LSTMKernel::Kernel avx512Kernel   { "avx512",   LSTMKernel::stepAVX512, LSTMKernel::stepAVX512, LSTMKernel::stepAVX512,
+                                                          LSTMKernel::stepAVX512GRU, LSTMKernel::stepAVX512GRU, LSTMKernel::stepAVX512GRU };
+   #endif
+   #if JUCE_ARM && JUCE_64BIT
+    const LSTMKernel::Kernel neonKernel     { "neon",     LSTMKernel::stepNEON, LSTMKernel::stepNEON, LSTMKernel::stepNEON,
+                                                          LSTMKernel::stepNEONGRU, LSTMKernel::stepNEONGRU, LSTMKernel::stepNEONGRU };
+   #endif
+}
+
+LSTMKERNEL_DEFINE_STEP (stepPortable)
+
+juce::Array<const LSTMKernel::Kernel*> LSTMKernel::getAvailable()
+{
+    juce::Array<const Kernel*> kernels;
+
+   #if JUCE_INTEL
+    if (juce::SystemStats::hasAVX512F() && juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3())
+        kernels.add (&avx512Kernel);
+
+    if (juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3())
+        kernels.add (&avx2Kernel);
+
+    if (juce::SystemStats::hasSSE2())
+        kernels.add (&sse2Kernel);
+   #endif
+
+   #if JUCE_ARM && JUCE_64BIT
+    kernels.add (&neonKernel); //NEON is part of the AArch64 baseline
+   #endif
+
+    kernels.add (&portableKernel);
+    return kernels;
+}
+
+const LSTMKernel::Kernel& LSTMKernel::select()
+{
+    //Worked out once per process, every processor instance gets the same answer
+    static const Kernel& chosen = []() -> const Kernel&
+    {
+        const auto available = getAvailable();
+        const auto forced = juce::SystemStats::getEnvironmentVariable ("NEURALSCREAMER_KERNEL", {});
+
+        for (auto* k : available)
+            if (forced.equalsIgnoreCase (k->name))
+                return *k;
+
+        return *available.getFirst();
+    }();
+
+    return chosen;
+}
@@ -0,0 +1,226 @@
+/*
+  ==============================================================================
+
+    LSTMKernel.h
+    Recurrent step kernels for BatchedLSTM, with runtime instruction set dispatch
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include "Activations.h"
+#include "LSTMWeights.h"
+#include "GRUWeights.h"
+
+
+/**
+    One recurrent step for every lane of a BatchedRNN, LSTM or GRU.
+
+    On entry lane l's gate row holds its input projection (bias included) in the
+    blocked column order of LSTMWeights or GRUWeights. The recurrent matvec is
+    accumulated into it one block of units at a time, and that block's cell update
+    runs straight after, so the gates never have to be re-read from memory.
+
+    Shapes with 8-unit blocks (every hidden size that is a multiple of 8) go
+    through one of the SIMD kernels in LSTMKernel_<isa>.cpp. Each of those files
+    is compiled for its own instruction set, and select() picks the widest one
+    the CPU supports at runtime, so a single binary runs everywhere.
+*/
+namespace LSTMKernel
+{
+    /** Largest hidden size the SIMD kernels keep scratch for. */
+    static constexpr int maxHiddenSize = 128;
+
+    /** gates is [numLanes][4 * hiddenSize], h and c are [numLanes][hiddenSize] (a GRU
+        doesn't touch c). The cell updates evaluate their activations at the given accuracy.
+    */
+    using StepFunction = void (*) (const float* recurrentKernel, float* gates, float* h, float* c,
+                                   int hiddenSize, int numLanes, ActivationAccuracy) noexcept;
+
+    /** The same step reading QuantizedWeights::recurrentHalf. */
+    using HalfStepFunction = void (*) (const std::uint16_t* recurrentKernel, float* gates, float* h, float* c,
+                                       int hiddenSize, int numLanes, ActivationAccuracy) noexcept;
+
+    /** The same step reading QuantizedWeights::recurrentInt8, scales is recurrentScale. */
+    using Int8StepFunction = void (*) (const std::int8_t* recurrentKernel, const float* scales, float* gates,
+                                       float* h, float* c, int hiddenSize, int numLanes, ActivationAccuracy) noexcept;
+
+    struct Kernel
+    {
+        const char* name;
+        StepFunction step;
+        HalfStepFunction stepHalf;
+        Int8StepFunction stepInt8;
+
+        //the same for GRUWeights
+        StepFunction stepGRU;
+        HalfStepFunction stepGRUHalf;
+        Int8StepFunction stepGRUInt8;
+    };
+
+    /** Best kernel for this CPU. Setting NEURALSCREAMER_KERNEL=<name> in the
+        environment forces a specific one, if the CPU supports it.
+    */
+    const Kernel& select();
+
+    /** Every kernel this CPU can run, widest first. Handy for benchmarks. */
+    juce::Array<const Kernel*> getAvailable();
+
+    //==============================================================================
+    // Implemented in LSTMKernel_<isa>.cpp; only call the ones getAvailable() returns.
+    // Each comes in fp32, fp16 and int8 flavours, overloaded on the weight type, and
+    // name##GRU is the GRU version.
+   #define LSTMKERNEL_DECLARE_STEP_FLAVOURS(name) \
+    void name (const float*, float*, float*, float*, int, int, ActivationAccuracy) noexcept; \
+    void name (const std::uint16_t*, float*, float*, float*, int, int, ActivationAccuracy) noexcept; \
+    void name (const std::int8_t*, const float*, float*, float*, float*, int, int, ActivationAccuracy) noexcept;
+   #define LSTMKERNEL_DECLARE_STEP(name) \
+    LSTMKERNEL_DECLARE_STEP_FLAVOURS (name) \
+    LSTMKERNEL_DECLARE_STEP_FLAVOURS (name##GRU)
+
+    LSTMKERNEL_DECLARE_STEP (stepPortable)
+   #if JUCE_INTEL
+    LSTMKERNEL_DECLARE_STEP (stepSSE2)
+    LSTMKERNEL_DECLARE_STEP (stepAVX2)
+    LSTMKERNEL_DECLARE_STEP (stepAVX512)
+   #endif
+   #if JUCE_ARM && JUCE_64BIT
+    LSTMKERNEL_DECLARE_STEP (stepNEON)
+   #endif
+   #undef LSTMKERNEL_DECLARE_STEP
+   #undef LSTMKERNEL_DECLARE_STEP_FLAVOURS
+
+    //==============================================================================
+    /** Cell update for U units of one block: g is [i(U) f(U) c(U) o(U)]. */
+    template <ActivationAccuracy accuracy, int U>
+    inline void cellUpdate (const float* g, float* c, float* hOut) noexcept
+    {
+        using Act = Activations::Tier<accuracy>;
+
+        for (int u = 0; u < U; ++u)
+        {
+            const auto i  = Act::sigmoid (g[u]);
+            const auto f  = Act::sigmoid (g[u + U]);
+            const auto cc = Act::tanh (g[u + 2 * U]);
+            const auto o  = Act::sigmoid (g[u + 3 * U]);
+
+            c[u] = f * c[u] + i * cc;
+            hOut[u] = o * Act::tanh (c[u]);
+        }
+    }
+
+    /** GRU update for U units of one block: g is [z(U) r(U) n(U)] with n the recurrent half
+        of the candidate, x the candidate's input half, h the state going in.
+    */
+    template <ActivationAccuracy accuracy, int U>
+    inline void gruUpdate (const float* g, const float* x, const float* h, float* hOut) noexcept
+    {
+        using Act = Activations::Tier<accuracy>;
+
+        for (int u = 0; u < U; ++u)
+        {
+            const auto z = Act::sigmoid (g[u]);
+            const auto r = Act::sigmoid (g[u + U]);
+            const auto n = Act::tanh (x[u] + r * g[u + 2 * U]);
+
+            hOut[u] = n + z * (h[u] - n);
+        }
+    }
+
+    inline float toFloat (float w) noexcept         { return w; }
+    inline float toFloat (std::uint16_t w) noexcept { return halfToFloat (w); }
+    inline float toFloat (std::int8_t w) noexcept   { return (float) w; }
+
+    /** Portable version for shapes the SIMD kernels don't cover. recurrent is laid out
+        like Weights::recurrentKernel; scales is only used (and needed) for int8.
+    */
+    template <typename Weights, int numLanes, ActivationAccuracy accuracy, typename T>
+    void stepGeneric (const T* recurrent, const float* scales, float (*gates)[Weights::numGates],
+                      float (*h)[Weights::numHidden], float (*c)[Weights::numHidden]) noexcept
+    {
+        constexpr int H  = Weights::numHidden;
+        constexpr int U  = Weights::unitsPerBlock;
+        constexpr int GB = Weights::gatesPerBlock;
+        constexpr bool scaled = std::is_same_v<T, std::int8_t>;
+
+        float hNext[numLanes][H];
+        float sums[numLanes][GB];
+
+        for (int b = 0; b < Weights::numBlocks; ++b)
+        {
+            //int8 rows are summed unscaled and the row's scale applied once at the end
+            for (int l = 0; l < numLanes; ++l)
+                for (int r = 0; r < GB; ++r)
+                    sums[l][r] = scaled ? 0.0f : gates[l][b * GB + r];
+
+            for (int k = 0; k < H; ++k)
+            {
+                const T* row = recurrent + (b * H + k) * GB;
+
+                for (int l = 0; l < numLanes; ++l)
+                {
+                    const auto hk = h[l][k];
+
+                    for (int r = 0; r < GB; ++r)
+                        sums[l][r] += toFloat (row[r]) * hk;
+                }
+            }
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                for (int r = 0; r < GB; ++r)
+                    gates[l][b * GB + r] = scaled ? gates[l][b * GB + r] + sums[l][r] * scales[b * GB + r] : sums[l][r];
+
+                if constexpr (Weights::cellType == CellType::gru)
+                    gruUpdate<accuracy, U> (gates[l] + b * GB, gates[l] + Weights::numRecurrentColumns + b * U, h[l] + b * U, hNext[l] + b * U);
+                else
+                    cellUpdate<accuracy, U> (gates[l] + b * GB, c[l] + b * U, hNext[l] + b * U);
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int j = 0; j < H; ++j)
+                h[l][j] = hNext[l][j];
+    }
+
+    /** Uses the dispatched kernel when the shape allows it, the portable one otherwise.
+        For anything but WeightPrecision::full the recurrent weights come from quantized.
+    */
+    template <typename Weights, int numLanes>
+    inline void step (const Kernel& kernel, WeightPrecision precision, ActivationAccuracy accuracy,
+                      const Weights& w, const QuantizedWeights<Weights>* quantized,
+                      float (*gates)[Weights::numGates], float (*h)[Weights::numHidden], float (*c)[Weights::numHidden]) noexcept
+    {
+        constexpr bool simd = Weights::unitsPerBlock == 8 && Weights::numHidden <= maxHiddenSize;
+        constexpr bool gru = Weights::cellType == CellType::gru;
+        constexpr int H = Weights::numHidden;
+
+        if constexpr (simd)
+        {
+            if (precision == WeightPrecision::half)
+                (gru ? kernel.stepGRUHalf : kernel.stepHalf) (&quantized->recurrentHalf[0][0][0], gates[0], h[0], c[0], H, numLanes, accuracy);
+            else if (precision == WeightPrecision::int8)
+                (gru ? kernel.stepGRUInt8 : kernel.stepInt8) (&quantized->recurrentInt8[0][0][0], quantized->recurrentScale, gates[0], h[0], c[0], H, numLanes, accuracy);
+            else
+                (gru ? kernel.stepGRU : kernel.step) (&w.recurrentKernel[0][0][0], gates[0], h[0], c[0], H, numLanes, accuracy);
+        }
+        else
+        {
+            Activations::dispatch (accuracy, [&] (auto tier)
+            {
+                constexpr auto a = decltype (tier)::value;
+
+                if (precision == WeightPrecision::half)
+                    stepGeneric<Weights, numLanes, a> (&quantized->recurrentHalf[0][0][0], nullptr, gates, h, c);
+                else if (precision == WeightPrecision::int8)
+                    stepGeneric<Weights, numLanes, a> (&quantized->recurrentInt8[0][0][0], quantized->recurrentScale, gates, h, c);
+                else
+                    stepGeneric<Weights, numLanes, a> (&w.recurrentKernel[0][0][0], nullptr, gates, h, c);
+            });
+        }
+    }
+}
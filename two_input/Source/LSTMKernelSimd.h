@@ -0,0 +1,464 @@
+/*
+  ==============================================================================
+
+    LSTMKernelSimd.h
+    Body of the SIMD recurrent kernels. Only meant to be included by the
+    LSTMKernel_<isa>.cpp files, inside an anonymous namespace and after the
+    file has switched on its instruction set, with exactly one of
+    LSTMKERNEL_AVX512, LSTMKERNEL_AVX2, LSTMKERNEL_SSE2, LSTMKERNEL_NEON or
+    LSTMKERNEL_PORTABLE defined. Everything here has internal linkage so no
+    code built for a wider instruction set can leak into the rest of the
+    binary through the linker.
+
+  ==============================================================================
+*/
+
+//==============================================================================
+// The activations' register type (see Activations.h): 8 floats where the instruction
+// set has them, 4 otherwise, and plain float for the portable kernel. Every tier but
+// exact evaluates a whole register of units at once.
+#if LSTMKERNEL_AVX512 || LSTMKERNEL_AVX2
+struct SimdFloat
+{
+    __m256 v;
+
+    SimdFloat (__m256 x) noexcept : v (x) {}
+    SimdFloat (float x) noexcept  : v (_mm256_set1_ps (x)) {}
+
+    static SimdFloat load (const float* p) noexcept { return _mm256_loadu_ps (p); }
+    void store (float* p) const noexcept            { _mm256_storeu_ps (p, v); }
+};
+
+static inline SimdFloat operator+ (SimdFloat a, SimdFloat b) noexcept { return _mm256_add_ps (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a, SimdFloat b) noexcept { return _mm256_sub_ps (a.v, b.v); }
+static inline SimdFloat operator* (SimdFloat a, SimdFloat b) noexcept { return _mm256_mul_ps (a.v, b.v); }
+static inline SimdFloat operator/ (SimdFloat a, SimdFloat b) noexcept { return _mm256_div_ps (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a) noexcept              { return _mm256_xor_ps (a.v, _mm256_set1_ps (-0.0f)); }
+
+static inline SimdFloat clamp (SimdFloat x, SimdFloat lo, SimdFloat hi) noexcept { return _mm256_min_ps (_mm256_max_ps (x.v, lo.v), hi.v); }
+static inline SimdFloat nearest (SimdFloat x) noexcept { return _mm256_round_ps (x.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+static inline SimdFloat pow2 (SimdFloat n) noexcept
+{
+    return _mm256_castsi256_ps (_mm256_slli_epi32 (_mm256_add_epi32 (_mm256_cvtps_epi32 (n.v), _mm256_set1_epi32 (127)), 23));
+}
+
+#elif LSTMKERNEL_SSE2
+struct SimdFloat
+{
+    __m128 v;
+
+    SimdFloat (__m128 x) noexcept : v (x) {}
+    SimdFloat (float x) noexcept  : v (_mm_set1_ps (x)) {}
+
+    static SimdFloat load (const float* p) noexcept { return _mm_loadu_ps (p); }
+    void store (float* p) const noexcept            { _mm_storeu_ps (p, v); }
+};
+
+static inline SimdFloat operator+ (SimdFloat a, SimdFloat b) noexcept { return _mm_add_ps (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a, SimdFloat b) noexcept { return _mm_sub_ps (a.v, b.v); }
+static inline SimdFloat operator* (SimdFloat a, SimdFloat b) noexcept { return _mm_mul_ps (a.v, b.v); }
+static inline SimdFloat operator/ (SimdFloat a, SimdFloat b) noexcept { return _mm_div_ps (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a) noexcept              { return _mm_xor_ps (a.v, _mm_set1_ps (-0.0f)); }
+
+static inline SimdFloat clamp (SimdFloat x, SimdFloat lo, SimdFloat hi) noexcept { return _mm_min_ps (_mm_max_ps (x.v, lo.v), hi.v); }
+
+//no round instruction before SSE4.1, but the conversion rounds to nearest and exp's inputs fit an int
+static inline SimdFloat nearest (SimdFloat x) noexcept { return _mm_cvtepi32_ps (_mm_cvtps_epi32 (x.v)); }
+static inline SimdFloat pow2 (SimdFloat n) noexcept
+{
+    return _mm_castsi128_ps (_mm_slli_epi32 (_mm_add_epi32 (_mm_cvtps_epi32 (n.v), _mm_set1_epi32 (127)), 23));
+}
+
+#elif LSTMKERNEL_NEON
+struct SimdFloat
+{
+    float32x4_t v;
+
+    SimdFloat (float32x4_t x) noexcept : v (x) {}
+    SimdFloat (float x) noexcept       : v (vdupq_n_f32 (x)) {}
+
+    static SimdFloat load (const float* p) noexcept { return vld1q_f32 (p); }
+    void store (float* p) const noexcept            { vst1q_f32 (p, v); }
+};
+
+static inline SimdFloat operator+ (SimdFloat a, SimdFloat b) noexcept { return vaddq_f32 (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a, SimdFloat b) noexcept { return vsubq_f32 (a.v, b.v); }
+static inline SimdFloat operator* (SimdFloat a, SimdFloat b) noexcept { return vmulq_f32 (a.v, b.v); }
+static inline SimdFloat operator/ (SimdFloat a, SimdFloat b) noexcept { return vdivq_f32 (a.v, b.v); }
+static inline SimdFloat operator- (SimdFloat a) noexcept              { return vnegq_f32 (a.v); }
+
+static inline SimdFloat clamp (SimdFloat x, SimdFloat lo, SimdFloat hi) noexcept { return vminq_f32 (vmaxq_f32 (x.v, lo.v), hi.v); }
+static inline SimdFloat nearest (SimdFloat x) noexcept { return vrndnq_f32 (x.v); }
+static inline SimdFloat pow2 (SimdFloat n) noexcept
+{
+    return vreinterpretq_f32_s32 (vshlq_n_s32 (vaddq_s32 (vcvtq_s32_f32 (n.v), vdupq_n_s32 (127)), 23));
+}
+
+#else // LSTMKERNEL_PORTABLE
+using SimdFloat = float;
+#endif
+
+/** The tiers' formulas again, so that they are compiled for this file's instruction set
+    (a template only gets the target options in force where it is defined).
+*/
+namespace SimdActivations
+{
+    using Activations::clamp;
+    using Activations::nearest;
+    using Activations::pow2;
+
+    #include "ActivationFormulas.h"
+}
+
+/** Loads and stores a register's worth of an 8-unit block. */
+template <typename V>
+struct SimdUnits
+{
+    static constexpr int width = (int) (sizeof (V) / sizeof (float));
+    static V load (const float* p) noexcept      { return V::load (p); }
+    static void store (float* p, V x) noexcept   { x.store (p); }
+};
+
+template <>
+struct SimdUnits<float>
+{
+    static constexpr int width = 1;
+    static float load (const float* p) noexcept     { return *p; }
+    static void store (float* p, float x) noexcept  { *p = x; }
+};
+
+/** What a tier's activations run on: exact is std::exp and std::tanh, one float at a time. */
+template <ActivationAccuracy accuracy>
+using SimdActivationType = std::conditional_t<accuracy == ActivationAccuracy::exact, float, SimdFloat>;
+
+/** One 8-unit LSTM block: g is [i(8) f(8) c(8) o(8)]. */
+template <ActivationAccuracy accuracy>
+struct SimdLSTMCell
+{
+    static constexpr int gatesPerBlock = 32;
+
+    static void update (const float* g, const float* /*candidateInput*/, const float* /*h*/, float* c, float* hOut) noexcept
+    {
+        using V = SimdActivationType<accuracy>;
+        using Units = SimdUnits<V>;
+        using Act = SimdActivations::Tier<accuracy>;
+
+        for (int u = 0; u < 8; u += Units::width)
+        {
+            const V i  = Act::sigmoid (Units::load (g + u));
+            const V f  = Act::sigmoid (Units::load (g + u + 8));
+            const V cc = Act::tanh (Units::load (g + u + 16));
+            const V o  = Act::sigmoid (Units::load (g + u + 24));
+
+            const V cNext = f * Units::load (c + u) + i * cc;
+            Units::store (c + u, cNext);
+            Units::store (hOut + u, o * Act::tanh (cNext));
+        }
+    }
+};
+
+/** One 8-unit GRU block: g is [z(8) r(8) n(8)], see GRUWeights. */
+template <ActivationAccuracy accuracy>
+struct SimdGRUCell
+{
+    static constexpr int gatesPerBlock = 24;
+
+    static void update (const float* g, const float* candidateInput, const float* h, float* /*c*/, float* hOut) noexcept
+    {
+        using V = SimdActivationType<accuracy>;
+        using Units = SimdUnits<V>;
+        using Act = SimdActivations::Tier<accuracy>;
+
+        for (int u = 0; u < 8; u += Units::width)
+        {
+            const V z = Act::sigmoid (Units::load (g + u));
+            const V r = Act::sigmoid (Units::load (g + u + 8));
+            const V n = Act::tanh (Units::load (candidateInput + u) + r * Units::load (g + u + 16));
+
+            Units::store (hOut + u, n + z * (Units::load (h + u) - n));
+        }
+    }
+};
+
+//==============================================================================
+// Weight loads for each instruction set: fp32 as is, fp16 and int8 widened to fp32.
+// LSTM rows are 32 gates wide and 64 byte aligned, GRU rows 24 wide, which keeps every
+// load up to 8 floats (or 8 halves) aligned. AVX-512 reads 16 at a time, so it doesn't
+// assume alignment, and reads the last 8 gates of a GRU row with simdLoadHalf().
+#if LSTMKERNEL_AVX512
+static inline __m512 simdLoad (const float* p) noexcept          { return _mm512_loadu_ps (p); }
+static inline __m512 simdLoad (const std::uint16_t* p) noexcept  { return _mm512_cvtph_ps (_mm256_loadu_si256 ((const __m256i*) p)); }
+static inline __m512 simdLoad (const std::int8_t* p) noexcept    { return _mm512_cvtepi32_ps (_mm512_cvtepi8_epi32 (_mm_loadu_si128 ((const __m128i*) p))); }
+
+//8 weights into the low half, zeros above
+static inline __m512 simdLoadHalf (const float* p) noexcept         { return _mm512_maskz_loadu_ps (0x00ff, p); }
+static inline __m512 simdLoadHalf (const std::uint16_t* p) noexcept { return _mm512_cvtph_ps (_mm256_set_m128i (_mm_setzero_si128(), _mm_loadu_si128 ((const __m128i*) p))); }
+static inline __m512 simdLoadHalf (const std::int8_t* p) noexcept   { return _mm512_cvtepi32_ps (_mm512_cvtepi8_epi32 (_mm_loadl_epi64 ((const __m128i*) p))); }
+
+#elif LSTMKERNEL_AVX2
+static inline __m256 simdLoad (const float* p) noexcept          { return _mm256_load_ps (p); }
+static inline __m256 simdLoad (const std::int8_t* p) noexcept    { return _mm256_cvtepi32_ps (_mm256_cvtepi8_epi32 (_mm_loadl_epi64 ((const __m128i*) p))); }
+
+//F16C isn't guaranteed alongside AVX2, so halves are widened with integer ops (see halfToFloat)
+static inline __m256 simdLoad (const std::uint16_t* p) noexcept
+{
+    const auto x = _mm256_cvtepu16_epi32 (_mm_load_si128 ((const __m128i*) p));
+    const auto magnitude = _mm256_slli_epi32 (_mm256_and_si256 (x, _mm256_set1_epi32 (0x7fff)), 13);
+    const auto sign = _mm256_slli_epi32 (_mm256_and_si256 (x, _mm256_set1_epi32 (0x8000)), 16);
+    const auto f = _mm256_mul_ps (_mm256_castsi256_ps (magnitude), _mm256_set1_ps (0x1.0p112f));
+    return _mm256_or_ps (f, _mm256_castsi256_ps (sign));
+}
+
+#elif LSTMKERNEL_SSE2
+static inline __m128 simdLoad (const float* p) noexcept { return _mm_load_ps (p); }
+
+static inline __m128 simdLoad (const std::uint16_t* p) noexcept
+{
+    const auto x = _mm_unpacklo_epi16 (_mm_loadl_epi64 ((const __m128i*) p), _mm_setzero_si128());
+    const auto magnitude = _mm_slli_epi32 (_mm_and_si128 (x, _mm_set1_epi32 (0x7fff)), 13);
+    const auto sign = _mm_slli_epi32 (_mm_and_si128 (x, _mm_set1_epi32 (0x8000)), 16);
+    const auto f = _mm_mul_ps (_mm_castsi128_ps (magnitude), _mm_set1_ps (0x1.0p112f));
+    return _mm_or_ps (f, _mm_castsi128_ps (sign));
+}
+
+static inline __m128 simdLoad (const std::int8_t* p) noexcept
+{
+    int bytes;
+    std::memcpy (&bytes, p, sizeof (bytes));
+
+    //SSE2 has no sign extension: spread each byte to the top of its lane and shift it back down
+    auto x = _mm_cvtsi32_si128 (bytes);
+    x = _mm_unpacklo_epi8 (x, x);
+    x = _mm_unpacklo_epi16 (x, x);
+    return _mm_cvtepi32_ps (_mm_srai_epi32 (x, 24));
+}
+
+#elif LSTMKERNEL_NEON
+static inline float32x4_t simdLoad (const float* p) noexcept         { return vld1q_f32 (p); }
+static inline float32x4_t simdLoad (const std::uint16_t* p) noexcept { return vcvt_f32_f16 (vreinterpret_f16_u16 (vld1_u16 (p))); }
+
+static inline float32x4_t simdLoad (const std::int8_t* p) noexcept
+{
+    std::int32_t bytes;
+    std::memcpy (&bytes, p, sizeof (bytes));
+    const auto x = vmovl_s8 (vreinterpret_s8_s32 (vdup_n_s32 (bytes)));
+    return vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (x)));
+}
+#endif
+
+/** One recurrent step for numLanes lanes of Cell (SimdLSTMCell or SimdGRUCell). T is float,
+    std::uint16_t (fp16) or std::int8_t; int8 sums are taken unscaled and multiplied by their
+    column's scale once per block.
+*/
+template <typename Cell, int numLanes, typename T>
+static void simdStep (const T* recurrent, const float* scales, float* gates, float* h, float* c, int hiddenSize) noexcept
+{
+    constexpr bool scaled = std::is_same_v<T, std::int8_t>;
+    constexpr int GB = Cell::gatesPerBlock;
+    const int G = 4 * hiddenSize;
+    const int numBlocks = hiddenSize / 8;
+    const int candidateInput = numBlocks * GB; //GRU only, see GRUWeights
+
+    float hNext[numLanes][LSTMKernel::maxHiddenSize];
+
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        const T* slab = recurrent + b * hiddenSize * GB;
+
+       #if LSTMKERNEL_AVX512
+        //the second register only holds 8 gates for a GRU
+        constexpr __mmask16 mask[2] { 0xffff, GB == 32 ? 0xffff : 0x00ff };
+
+        __m512 acc[numLanes][2];
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < 2; ++q)
+                acc[l][q] = scaled ? _mm512_setzero_ps() : _mm512_maskz_loadu_ps (mask[q], gates + l * G + b * GB + 16 * q);
+
+        for (int k = 0; k < hiddenSize; ++k)
+        {
+            const T* row = slab + k * GB;
+            const auto w0 = simdLoad (row);
+            const auto w1 = GB == 32 ? simdLoad (row + 16) : simdLoadHalf (row + 16);
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                const auto hk = _mm512_set1_ps (h[l * hiddenSize + k]);
+                acc[l][0] = _mm512_fmadd_ps (w0, hk, acc[l][0]);
+                acc[l][1] = _mm512_fmadd_ps (w1, hk, acc[l][1]);
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < 2; ++q)
+            {
+                auto* g = gates + l * G + b * GB + 16 * q;
+                if constexpr (scaled)
+                    acc[l][q] = _mm512_fmadd_ps (acc[l][q], _mm512_maskz_loadu_ps (mask[q], scales + b * GB + 16 * q), _mm512_maskz_loadu_ps (mask[q], g));
+
+                _mm512_mask_storeu_ps (g, mask[q], acc[l][q]);
+            }
+
+       #elif LSTMKERNEL_AVX2
+        constexpr int numRegs = GB / 8;
+        __m256 acc[numLanes][numRegs];
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+                acc[l][q] = scaled ? _mm256_setzero_ps() : _mm256_loadu_ps (gates + l * G + b * GB + 8 * q);
+
+        for (int k = 0; k < hiddenSize; ++k)
+        {
+            const T* row = slab + k * GB;
+            __m256 w[numRegs];
+            for (int q = 0; q < numRegs; ++q)
+                w[q] = simdLoad (row + 8 * q);
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                const auto hk = _mm256_set1_ps (h[l * hiddenSize + k]);
+                for (int q = 0; q < numRegs; ++q)
+                    acc[l][q] = _mm256_fmadd_ps (w[q], hk, acc[l][q]);
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+            {
+                auto* g = gates + l * G + b * GB + 8 * q;
+                if constexpr (scaled)
+                    acc[l][q] = _mm256_fmadd_ps (acc[l][q], _mm256_loadu_ps (scales + b * GB + 8 * q), _mm256_loadu_ps (g));
+
+                _mm256_storeu_ps (g, acc[l][q]);
+            }
+
+       #elif LSTMKERNEL_SSE2
+        constexpr int numRegs = GB / 4;
+        __m128 acc[numLanes][numRegs];
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+                acc[l][q] = scaled ? _mm_setzero_ps() : _mm_loadu_ps (gates + l * G + b * GB + 4 * q);
+
+        for (int k = 0; k < hiddenSize; ++k)
+        {
+            const T* row = slab + k * GB;
+            __m128 w[numRegs];
+            for (int q = 0; q < numRegs; ++q)
+                w[q] = simdLoad (row + 4 * q);
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                const auto hk = _mm_set1_ps (h[l * hiddenSize + k]);
+                for (int q = 0; q < numRegs; ++q)
+                    acc[l][q] = _mm_add_ps (acc[l][q], _mm_mul_ps (w[q], hk));
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+            {
+                auto* g = gates + l * G + b * GB + 4 * q;
+                if constexpr (scaled)
+                    acc[l][q] = _mm_add_ps (_mm_loadu_ps (g), _mm_mul_ps (acc[l][q], _mm_loadu_ps (scales + b * GB + 4 * q)));
+
+                _mm_storeu_ps (g, acc[l][q]);
+            }
+
+       #elif LSTMKERNEL_NEON
+        constexpr int numRegs = GB / 4;
+        float32x4_t acc[numLanes][numRegs];
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+                acc[l][q] = scaled ? vdupq_n_f32 (0.0f) : vld1q_f32 (gates + l * G + b * GB + 4 * q);
+
+        for (int k = 0; k < hiddenSize; ++k)
+        {
+            const T* row = slab + k * GB;
+            float32x4_t w[numRegs];
+            for (int q = 0; q < numRegs; ++q)
+                w[q] = simdLoad (row + 4 * q);
+
+            for (int l = 0; l < numLanes; ++l)
+            {
+                const auto hk = vdupq_n_f32 (h[l * hiddenSize + k]);
+                for (int q = 0; q < numRegs; ++q)
+                    acc[l][q] = vfmaq_f32 (acc[l][q], w[q], hk);
+            }
+        }
+
+        for (int l = 0; l < numLanes; ++l)
+            for (int q = 0; q < numRegs; ++q)
+            {
+                auto* g = gates + l * G + b * GB + 4 * q;
+                if constexpr (scaled)
+                    acc[l][q] = vfmaq_f32 (vld1q_f32 (g), acc[l][q], vld1q_f32 (scales + b * GB + 4 * q));
+
+                vst1q_f32 (g, acc[l][q]);
+            }
+
+       #else // LSTMKERNEL_PORTABLE
+        for (int l = 0; l < numLanes; ++l)
+        {
+            float sums[GB];
+            for (int r = 0; r < GB; ++r)
+                sums[r] = scaled ? 0.0f : gates[l * G + b * GB + r];
+
+            for (int k = 0; k < hiddenSize; ++k)
+            {
+                const T* row = slab + k * GB;
+                const auto hk = h[l * hiddenSize + k];
+
+                for (int r = 0; r < GB; ++r)
+                    sums[r] += LSTMKernel::toFloat (row[r]) * hk;
+            }
+
+            for (int r = 0; r < GB; ++r)
+                gates[l * G + b * GB + r] = scaled ? gates[l * G + b * GB + r] + sums[r] * scales[b * GB + r] : sums[r];
+        }
+       #endif
+
+        for (int l = 0; l < numLanes; ++l)
+            Cell::update (gates + l * G + b * GB, gates + l * G + candidateInput + b * 8,
+                          h + l * hiddenSize + b * 8, c + l * hiddenSize + b * 8, hNext[l] + b * 8);
+    }
+
+    for (int l = 0; l < numLanes; ++l)
+        for (int j = 0; j < hiddenSize; ++j)
+            h[l * hiddenSize + j] = hNext[l][j];
+}
+
+/** Walks the lanes in the widest groups the accumulators fit in registers for, with the
+    Cell (SimdLSTMCell or SimdGRUCell) for the activation accuracy.
+*/
+template <template <ActivationAccuracy> class Cell, typename T>
+static void simdStepLanes (const T* recurrent, const float* scales, float* gates, float* h, float* c,
+                           int hiddenSize, int numLanes, ActivationAccuracy accuracy) noexcept
+{
+    Activations::dispatch (accuracy, [&] (auto tier)
+    {
+        using TierCell = Cell<decltype (tier)::value>;
+        const int G = 4 * hiddenSize;
+        int l = 0;
+
+        for (; l + 2 <= numLanes; l += 2)
+            simdStep<TierCell, 2> (recurrent, scales, gates + l * G, h + l * hiddenSize, c + l * hiddenSize, hiddenSize);
+
+        if (l < numLanes)
+            simdStep<TierCell, 1> (recurrent, scales, gates + l * G, h + l * hiddenSize, c + l * hiddenSize, hiddenSize);
+    });
+}
+
+/** Defines the fp32, fp16 and int8 overloads of LSTMKernel::name for one Cell. */
+#define LSTMKERNEL_DEFINE_STEP_FLAVOURS(name, Cell) \
+    void LSTMKernel::name (const float* recurrent, float* gates, float* h, float* c, int hiddenSize, int numLanes, \
+                           ActivationAccuracy accuracy) noexcept \
+    { simdStepLanes<Cell> (recurrent, nullptr, gates, h, c, hiddenSize, numLanes, accuracy); } \
+    void LSTMKernel::name (const std::uint16_t* recurrent, float* gates, float* h, float* c, int hiddenSize, int numLanes, \
+                           ActivationAccuracy accuracy) noexcept \
+    { simdStepLanes<Cell> (recurrent, nullptr, gates, h, c, hiddenSize, numLanes, accuracy); } \
+    void LSTMKernel::name (const std::int8_t* recurrent, const float* scales, float* gates, float* h, float* c, int hiddenSize, \
+                           int numLanes, ActivationAccuracy accuracy) noexcept \
+    { simdStepLanes<Cell> (recurrent, scales, gates, h, c, hiddenSize, numLanes, accuracy); }
+
+/** Defines LSTMKernel::name and LSTMKernel::name##GRU as declared in LSTMKernel.h. */
+#define LSTMKERNEL_DEFINE_STEP(name) \
+    LSTMKERNEL_DEFINE_STEP_FLAVOURS (name, SimdLSTMCell) \
+    LSTMKERNEL_DEFINE_STEP_FLAVOURS (name##GRU, SimdGRUCell)
@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    LSTMKernel_AVX2.cpp
+    AVX2 build of the recurrent kernel, see LSTMKernelSimd.h
+
+  ==============================================================================
+*/
+
+#include "LSTMKernel.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+
+ #if JUCE_CLANG
+  #pragma clang attribute push (__attribute__ ((target ("avx2,fma"))), apply_to = function)
+ #elif JUCE_GCC
+  #pragma GCC push_options
+  #pragma GCC target ("avx2,fma")
+ #endif
+
+namespace
+{
+    #define LSTMKERNEL_AVX2 1
+    #include "LSTMKernelSimd.h"
+    #undef LSTMKERNEL_AVX2
+}
+
+LSTMKERNEL_DEFINE_STEP (stepAVX2)
+
+ #if JUCE_CLANG
+  #pragma clang attribute pop
+ #elif JUCE_GCC
+  #pragma GCC pop_options
+ #endif
+#endif
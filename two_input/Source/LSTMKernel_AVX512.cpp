@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    LSTMKernel_AVX512.cpp
+    AVX512 build of the recurrent kernel, see LSTMKernelSimd.h
+
+  ==============================================================================
+*/
+
+#include "LSTMKernel.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+
+ #if JUCE_CLANG
+  #pragma clang attribute push (__attribute__ ((target ("avx512f,avx2,fma"))), apply_to = function)
+ #elif JUCE_GCC
+  #pragma GCC push_options
+  #pragma GCC target ("avx512f,avx2,fma")
+ #endif
+
+namespace
+{
+    #define LSTMKERNEL_AVX512 1
+    #include "LSTMKernelSimd.h"
+    #undef LSTMKERNEL_AVX512
+}
+
+LSTMKERNEL_DEFINE_STEP (stepAVX512)
+
+ #if JUCE_CLANG
+  #pragma clang attribute pop
+ #elif JUCE_GCC
+  #pragma GCC pop_options
+ #endif
+#endif
@@ -0,0 +1,23 @@
+/*
+  ==============================================================================
+
+    LSTMKernel_NEON.cpp
+    NEON build of the recurrent kernel, see LSTMKernelSimd.h
+
+  ==============================================================================
+*/
+
+#include "LSTMKernel.h"
+
+#if JUCE_ARM && JUCE_64BIT
+ #include <arm_neon.h>
+
+namespace
+{
+    #define LSTMKERNEL_NEON 1
+    #include "LSTMKernelSimd.h"
+    #undef LSTMKERNEL_NEON
+}
+
+LSTMKERNEL_DEFINE_STEP (stepNEON)
+#endif
@@ -0,0 +1,36 @@
+/*
+  ==============================================================================
+
+    LSTMKernel_SSE2.cpp
+    SSE2 build of the recurrent kernel, see LSTMKernelSimd.h
+
+  ==============================================================================
+*/
+
+#include "LSTMKernel.h"
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+
+ #if JUCE_CLANG
+  #pragma clang attribute push (__attribute__ ((target ("sse2"))), apply_to = function)
+ #elif JUCE_GCC
+  #pragma GCC push_options
+  #pragma GCC target ("sse2")
+ #endif
+
+namespace
+{
+    #define LSTMKERNEL_SSE2 1
+    #include "LSTMKernelSimd.h"
+    #undef LSTMKERNEL_SSE2
+}
+
+LSTMKERNEL_DEFINE_STEP (stepSSE2)
+
+ #if JUCE_CLANG
+  #pragma clang attribute pop
+ #elif JUCE_GCC
+  #pragma GCC pop_options
+ #endif
+#endif
@@ -0,0 +1,316 @@
+/*
+  ==============================================================================
+
+    LSTMWeights.h
+    Read-only weights for the LSTM + Dense networks exported by model.py
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "RTNeural.h"
+
+
+/** Recurrent layers the plugin can run, see the JSON export's layers[].type. */
+enum class CellType { lstm, gru };
+
+/** "lstm" or "gru", as the JSON export names them. */
+inline const char* getCellTypeName (CellType cell) noexcept
+{
+    return cell == CellType::gru ? "gru" : "lstm";
+}
+
+
+/**
+    Header of the .nsw files written by Python/export_binary.py: 20 bytes, a magic that
+    names the cell type ("NSW1" for an LSTM, "NSG1" for a GRU), then little-endian
+    uint32 version, inSize, hiddenSize and unitsPerBlock. The weight arrays follow it
+    in the declaration order of the weights struct, already in its blocked layout.
+*/
+struct NswHeader
+{
+    char magic[4];
+    std::uint32_t version, inputs, hidden, units;
+
+    static constexpr std::uint32_t currentVersion = 1;
+
+    static const char* getMagic (CellType cell) noexcept { return cell == CellType::gru ? "NSG1" : "NSW1"; }
+
+    /** Copies the header out of data. False if it is too short or not a .nsw file. */
+    static bool read (const void* data, size_t size, NswHeader& header) noexcept
+    {
+        if (data == nullptr || size < sizeof (NswHeader))
+            return false;
+
+        std::memcpy (&header, data, sizeof (NswHeader));
+        return header.version == currentVersion && (header.is (CellType::lstm) || header.is (CellType::gru));
+    }
+
+    bool is (CellType cell) const noexcept { return std::memcmp (magic, getMagic (cell), 4) == 0; }
+};
+
+static_assert (sizeof (NswHeader) == 20, "header must be packed");
+
+
+/** Loads a .nsw file into an LSTMWeights or GRUWeights. Returns false if the data
+    doesn't match Weights' cell type and shape, so callers can fall back to loadJson().
+*/
+template <typename Weights>
+bool loadNswBinary (Weights& w, const void* data, size_t size)
+{
+    constexpr auto payload = sizeof (w.inputKernel) + sizeof (w.recurrentKernel) + sizeof (w.bias)
+                           + sizeof (w.denseKernel) + sizeof (w.denseBias);
+
+    NswHeader header;
+    if (! NswHeader::read (data, size, header) || size != sizeof (NswHeader) + payload)
+        return false;
+
+    if (! header.is (Weights::cellType) || header.inputs != (std::uint32_t) Weights::numInputs
+         || header.hidden != (std::uint32_t) Weights::numHidden || header.units != (std::uint32_t) Weights::unitsPerBlock)
+        return false;
+
+    auto* src = static_cast<const char*> (data) + sizeof (NswHeader);
+    auto read = [&src] (void* dest, size_t bytes) { std::memcpy (dest, src, bytes); src += bytes; };
+
+    read (w.inputKernel, sizeof (w.inputKernel));
+    read (w.recurrentKernel, sizeof (w.recurrentKernel));
+    read (w.bias, sizeof (w.bias));
+    read (w.denseKernel, sizeof (w.denseKernel));
+    read (&w.denseBias, sizeof (w.denseBias));
+    return true;
+}
+
+
+/**
+    Weights of an LSTM(inSize -> hiddenSize) followed by a Dense(hiddenSize -> 1).
+
+    Gate columns are stored in blocks of unitsPerBlock hidden units, each block
+    holding that block's i, f, c and o gates back to back:
+
+        [ i(u0..u7) f(u0..u7) c(u0..u7) o(u0..u7) ] [ i(u8..u15) ... ] ...
+
+    so a kernel can finish the matvec for one block and apply the cell update
+    while all four gates are still in registers. The recurrent kernel is stored
+    block-major ([block][k][gate column]) so each block streams through one
+    contiguous, cache-line aligned slab. Hidden sizes that aren't a multiple of
+    8 use a single block, which is the plain Keras i, f, c, o order.
+*/
+template <int inSize, int hiddenSize>
+struct LSTMWeights
+{
+    static constexpr CellType cellType = CellType::lstm;
+    static constexpr int numInputs = inSize;
+    static constexpr int numHidden = hiddenSize;
+    static constexpr int numGates  = 4 * hiddenSize;
+
+    static constexpr int unitsPerBlock = hiddenSize % 8 == 0 ? 8 : hiddenSize;
+    static constexpr int numBlocks     = hiddenSize / unitsPerBlock;
+    static constexpr int gatesPerBlock = 4 * unitsPerBlock;
+
+    /** Gate columns the recurrent kernel feeds, all of them for an LSTM. */
+    static constexpr int numRecurrentColumns = numGates;
+
+    /** Where Keras gate column (gate * hiddenSize + unit) lives in this layout. */
+    static constexpr int column (int gate, int unit) noexcept
+    {
+        return (unit / unitsPerBlock) * gatesPerBlock + gate * unitsPerBlock + unit % unitsPerBlock;
+    }
+
+    alignas (64) float inputKernel[inSize][numGates] {};
+    alignas (64) float recurrentKernel[numBlocks][hiddenSize][gatesPerBlock] {};
+    alignas (64) float bias[numGates] {};
+    alignas (64) float denseKernel[hiddenSize] {};
+    float denseBias {0.0f};
+
+    /** Loads the binary format written by Python/export_binary.py, see NswHeader. */
+    bool loadBinary (const void* data, size_t size) { return loadNswBinary (*this, data, size); }
+
+    /** Loads an RTNeural-style export. Returns false if the architecture doesn't match. */
+    bool loadJson (const nlohmann::json& modelJson)
+    {
+        const auto& layers = modelJson.at ("layers");
+        if (layers.size() != 2 || layers[0].at ("type") != "lstm" || layers[1].at ("type") != "dense")
+            return false;
+
+        const auto& lstm = layers[0].at ("weights");
+        const auto& dense = layers[1].at ("weights");
+
+        if (lstm.size() != 3 || lstm[0].size() != (size_t) inSize || lstm[1].size() != (size_t) hiddenSize
+             || lstm[2].size() != (size_t) numGates)
+            return false;
+
+        if (dense.size() != 2 || dense[0].size() != (size_t) hiddenSize || dense[1].size() != 1)
+            return false;
+
+        for (int gate = 0; gate < 4; ++gate)
+        {
+            for (int unit = 0; unit < hiddenSize; ++unit)
+            {
+                const auto src = gate * hiddenSize + unit;
+                const auto dst = column (gate, unit);
+
+                for (int k = 0; k < inSize; ++k)
+                    inputKernel[k][dst] = lstm[0][k][src].get<float>();
+
+                for (int k = 0; k < hiddenSize; ++k)
+                    recurrentKernel[dst / gatesPerBlock][k][dst % gatesPerBlock] = lstm[1][k][src].get<float>();
+
+                bias[dst] = lstm[2][src].get<float>();
+            }
+        }
+
+        for (int k = 0; k < hiddenSize; ++k)
+            denseKernel[k] = dense[0][k][0].get<float>();
+
+        denseBias = dense[1][0].get<float>();
+        return true;
+    }
+};
+
+
+//==============================================================================
+/** Storage the recurrent and Dense weights are read from while the network runs. */
+enum class WeightPrecision
+{
+    full,   //fp32, bit-exact with the exported model
+    half,   //fp16 storage, fp32 arithmetic
+    int8    //int8 with one fp32 scale per output row, fp32 arithmetic
+};
+
+/** IEEE half to float. Exact for every half that isn't inf or NaN, subnormals included. */
+inline float halfToFloat (std::uint16_t h) noexcept
+{
+    //move exponent and mantissa into place, then rebias the exponent from 15 to 127
+    const std::uint32_t magnitude = (std::uint32_t) (h & 0x7fff) << 13;
+    float f;
+    std::memcpy (&f, &magnitude, sizeof (f));
+    f *= 0x1.0p112f;
+    return (h & 0x8000) != 0 ? -f : f;
+}
+
+/** Float to IEEE half, rounding to nearest even. */
+inline std::uint16_t floatToHalf (float value) noexcept
+{
+    std::uint32_t x;
+    std::memcpy (&x, &value, sizeof (x));
+
+    const auto sign = (std::uint16_t) ((x >> 16) & 0x8000);
+    x &= 0x7fffffff;
+
+    if (x >= 0x47800000) //too big for a half (or inf / NaN)
+        return (std::uint16_t) (sign | 0x7c00);
+
+    if (x < 0x38800000) //below the smallest normal half: value * 2^24 is the subnormal mantissa
+    {
+        float magnitude;
+        std::memcpy (&magnitude, &x, sizeof (magnitude));
+        return (std::uint16_t) (sign | (std::uint16_t) std::nearbyint (magnitude * 0x1.0p24f));
+    }
+
+    x -= (127 - 15) << 23;
+    x += 0x0fff + ((x >> 13) & 1);
+    return (std::uint16_t) (sign | (x >> 13));
+}
+
+
+/**
+    Reduced precision copies of an LSTMWeights' or GRUWeights' recurrent and Dense
+    weights, for WeightPrecision::half and WeightPrecision::int8.
+
+    The recurrent kernel is what every channel reads every sample, 64 KB at fp32 for
+    64 units. Here it is 32 KB as fp16 and 16 KB as int8, so it stays in L1 on most
+    CPUs and many more instances fit in the shared caches. Both copies use the same
+    blocked layout as Full. The int8 copy has one scale per recurrent gate column (a
+    row of the Keras matrix), in that same column order.
+
+    The input kernel and the biases are only a few hundred floats, so the network
+    keeps reading those from the fp32 weights.
+*/
+template <typename FullWeights>
+struct QuantizedWeights
+{
+    using Full = FullWeights;
+
+    static constexpr int hiddenSize    = Full::numHidden;
+    static constexpr int numHidden     = hiddenSize;
+    static constexpr int numColumns    = Full::numRecurrentColumns;
+    static constexpr int numBlocks     = Full::numBlocks;
+    static constexpr int gatesPerBlock = Full::gatesPerBlock;
+
+    alignas (64) std::uint16_t recurrentHalf[numBlocks][hiddenSize][gatesPerBlock] {};
+    alignas (64) std::int8_t recurrentInt8[numBlocks][hiddenSize][gatesPerBlock] {};
+    alignas (64) float recurrentScale[numColumns] {};
+
+    alignas (64) std::uint16_t denseHalf[hiddenSize] {};
+    alignas (64) std::int8_t denseInt8[hiddenSize] {};
+    float denseScale {1.0f};
+
+    /** Fills both copies from full precision weights. */
+    void quantize (const Full& full)
+    {
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (int r = 0; r < gatesPerBlock; ++r)
+            {
+                auto peak = 0.0f;
+                for (int k = 0; k < hiddenSize; ++k)
+                    peak = std::max (peak, std::abs (full.recurrentKernel[b][k][r]));
+
+                const auto scale = peak > 0.0f ? peak / 127.0f : 1.0f;
+                recurrentScale[b * gatesPerBlock + r] = scale;
+
+                for (int k = 0; k < hiddenSize; ++k)
+                {
+                    const auto w = full.recurrentKernel[b][k][r];
+                    recurrentHalf[b][k][r] = floatToHalf (w);
+                    recurrentInt8[b][k][r] = toInt8 (w / scale);
+                }
+            }
+        }
+
+        auto peak = 0.0f;
+        for (int k = 0; k < hiddenSize; ++k)
+            peak = std::max (peak, std::abs (full.denseKernel[k]));
+
+        denseScale = peak > 0.0f ? peak / 127.0f : 1.0f;
+
+        for (int k = 0; k < hiddenSize; ++k)
+        {
+            denseHalf[k] = floatToHalf (full.denseKernel[k]);
+            denseInt8[k] = toInt8 (full.denseKernel[k] / denseScale);
+        }
+    }
+
+    /** Quantizes straight from the exported JSON. Returns false if the architecture doesn't match. */
+    bool loadJson (const nlohmann::json& modelJson)
+    {
+        auto full = std::make_unique<Full>();
+        if (! full->loadJson (modelJson))
+            return false;
+
+        quantize (*full);
+        return true;
+    }
+
+    /** Quantizes from the .nsw format, see NswHeader. */
+    bool loadBinary (const void* data, size_t size)
+    {
+        auto full = std::make_unique<Full>();
+        if (! full->loadBinary (data, size))
+            return false;
+
+        quantize (*full);
+        return true;
+    }
+
+private:
+    static std::int8_t toInt8 (float x) noexcept
+    {
+        return (std::int8_t) std::clamp ((int) std::lround (x), -127, 127);
+    }
+};
@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    ModelDispatch.h
+    Picks the compiled network type that matches an exported model's architecture
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+#include <string>
+#include "BatchedLSTM.h"
+#include "ModelLoader.h"
+
+
+/** What an export contains: its recurrent layer's type, inputs and width. */
+struct ModelArchitecture
+{
+    CellType cell {CellType::lstm};
+    int numInputs {0};
+    int hiddenSize {0};
+
+    bool isValid() const noexcept { return numInputs > 0 && hiddenSize > 0; }
+
+    /** Read from the .nsw header if there is one, which costs nothing, otherwise from
+        the JSON's layers[0] type and shape. Not realtime safe. Invalid if neither
+        resource is in the binary or the first layer isn't an LSTM or GRU.
+    */
+    static ModelArchitecture read (const char* binaryResource, const char* jsonResource)
+    {
+        int size = 0;
+        NswHeader header;
+
+        if (auto* data = BinaryData::getNamedResource (binaryResource, size))
+            if (NswHeader::read (data, (size_t) size, header))
+                return { header.is (CellType::gru) ? CellType::gru : CellType::lstm, (int) header.inputs, (int) header.hidden };
+
+        if (auto* data = BinaryData::getNamedResource (jsonResource, size))
+            return fromJson (nlohmann::json::parse (data, data + size));
+
+        return {};
+    }
+
+    static ModelArchitecture fromJson (const nlohmann::json& modelJson)
+    {
+        const auto& layers = modelJson.at ("layers");
+        if (layers.size() == 0)
+            return {};
+
+        const auto& layer = layers[0];
+        const auto& type = layer.at ("type");
+        const auto& weights = layer.at ("weights");
+
+        if ((type != "lstm" && type != "gru") || weights.size() < 2)
+            return {};
+
+        //the kernel is [inputs][gates] and the recurrent kernel [hidden][gates], which
+        //is what layers[0].shape ends in too
+        return { type == "gru" ? CellType::gru : CellType::lstm, (int) weights[0].size(), (int) weights[1].size() };
+    }
+};
+
+
+//==============================================================================
+/**
+    A NeuralModel and its lazily loaded weights, with the type of network hidden
+    behind virtual calls, so a ModelFamily can hold whatever an export turns out to
+    be. The virtual calls are per block, never per sample.
+*/
+class RecurrentModel
+{
+public:
+    virtual ~RecurrentModel() = default;
+
+    virtual ModelArchitecture getArchitecture() const noexcept = 0;
+
+    /** Loads the weights (and the reduced precision copy if needed) on the calling
+        thread. Never call from the audio thread.
+    */
+    virtual void loadNow (WeightPrecision precision) = 0;
+
+    /** Asks the loader thread for the weights. Realtime safe. */
+    virtual void requestLoad (WeightPrecision precision) noexcept = 0;
+
+    virtual bool isLoaded() const noexcept = 0;
+
+    /** Hands the network whatever weights have been published so far. Realtime safe. */
+    virtual void updateWeights (WeightPrecision precision) noexcept = 0;
+
+    virtual void setKernel (const LSTMKernel::Kernel& kernel) = 0;
+
+    virtual void setActivationAccuracy (ActivationAccuracy accuracy) noexcept = 0;
+
+    /** Not realtime safe. */
+    virtual void prepare (int numChannels, int maxBlockSize) = 0;
+
+    virtual void setIdleDetection (float threshold, int holdSamples) noexcept = 0;
+
+    /** See NeuralModel::setWorkerPool(). Not realtime safe. */
+    virtual void setWorkerPool (WorkerPool* pool) noexcept = 0;
+
+    /** Clears the hidden state. Realtime safe. */
+    virtual void reset() noexcept = 0;
+
+    /** Runs the network in place if it has weights, see NeuralModel::process(). */
+    virtual void process (float* const* channels, int numChannels, const SubBlockRun* runs, int numRuns,
+                          OutputStage* output, bool parallel) noexcept = 0;
+};
+
+
+/** The RecurrentModel for one compiled weights type. */
+template <typename WeightsType>
+class RecurrentModelOf final : public RecurrentModel
+{
+public:
+    using Model = NeuralModel<WeightsType>;
+
+    RecurrentModelOf (const char* binaryResource, const char* jsonResource)
+        : weights (binaryResource, jsonResource),
+          quantized (binaryResource, jsonResource)
+    {
+    }
+
+    ModelArchitecture getArchitecture() const noexcept override
+    {
+        return { WeightsType::cellType, WeightsType::numInputs, WeightsType::numHidden };
+    }
+
+    void loadNow (WeightPrecision precision) override
+    {
+        weights.loadNow();
+
+        if (precision != WeightPrecision::full)
+            quantized.loadNow();
+    }
+
+    void requestLoad (WeightPrecision precision) noexcept override
+    {
+        weights.requestLoad();
+
+        if (precision != WeightPrecision::full)
+            quantized.requestLoad();
+    }
+
+    bool isLoaded() const noexcept override { return weights.isLoaded(); }
+
+    void updateWeights (WeightPrecision precision) noexcept override
+    {
+        net.setWeights (weights.get());
+        net.setQuantizedWeights (quantized.get());
+        net.setPrecision (precision);
+    }
+
+    void setKernel (const LSTMKernel::Kernel& kernel) override { net.setKernel (kernel); }
+
+    void setActivationAccuracy (ActivationAccuracy accuracy) noexcept override { net.setActivationAccuracy (accuracy); }
+
+    void prepare (int numChannels, int maxBlockSize) override { net.prepare (numChannels, maxBlockSize); }
+
+    void setIdleDetection (float threshold, int holdSamples) noexcept override { net.setIdleDetection (threshold, holdSamples); }
+
+    void setWorkerPool (WorkerPool* pool) noexcept override { net.setWorkerPool (pool); }
+
+    void reset() noexcept override { net.reset(); }
+
+    void process (float* const* channels, int numChannels, const SubBlockRun* runs, int numRuns,
+                  OutputStage* output, bool parallel) noexcept override
+    {
+        if (net.hasWeights())
+            net.process (channels, numChannels, runs, numRuns, output, parallel);
+    }
+
+private:
+    LazyWeights<WeightsType> weights;
+    LazyWeights<typename Model::Quantized> quantized;
+    Model net;
+
+    JUCE_DECLARE_NON_COPYABLE (RecurrentModelOf)
+};
+
+
+//==============================================================================
+/**
+    Every network type compiled into the plugin: an LSTM and a GRU at each of
+    hiddenSizes, all with NeuralModel's two inputs. create() looks the architecture
+    of an export up in the table and builds the matching RecurrentModelOf, so
+    supporting another shape is one more entry rather than another member variable.
+*/
+template <int... hiddenSizes>
+struct ModelDispatch
+{
+    using Factory = std::unique_ptr<RecurrentModel> (*) (const char* binaryResource, const char* jsonResource);
+
+    struct Entry
+    {
+        ModelArchitecture architecture;
+        Factory create;
+    };
+
+    /** nullptr if nothing compiled in matches. The names must outlive the model. */
+    static std::unique_ptr<RecurrentModel> create (const ModelArchitecture& architecture,
+                                                   const char* binaryResource, const char* jsonResource)
+    {
+        for (const auto& entry : table)
+            if (entry.architecture.cell == architecture.cell && entry.architecture.numInputs == architecture.numInputs
+                 && entry.architecture.hiddenSize == architecture.hiddenSize)
+                return entry.create (binaryResource, jsonResource);
+
+        return {};
+    }
+
+private:
+    template <typename Weights>
+    static std::unique_ptr<RecurrentModel> make (const char* binaryResource, const char* jsonResource)
+    {
+        return std::make_unique<RecurrentModelOf<Weights>> (binaryResource, jsonResource);
+    }
+
+    template <typename Weights>
+    static Entry entry() noexcept
+    {
+        return { { Weights::cellType, Weights::numInputs, Weights::numHidden }, &make<Weights> };
+    }
+
+    static constexpr int numInputs = 2;
+
+    static inline const Entry table[] { entry<LSTMWeights<numInputs, hiddenSizes>>()...,
+                                        entry<GRUWeights<numInputs, hiddenSizes>>()... };
+};
@@ -0,0 +1,202 @@
+/*
+  ==============================================================================
+
+    ModelFamily.h
+    One pedal model trained at several hidden sizes, switchable while playing
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <memory>
+#include <string>
+#include "ModelDispatch.h"
+
+
+/**
+    The same pedal at each of hiddenSizes (ascending), for trading fidelity for CPU.
+
+    Each size is its own export of the model (see Python/model.py --hidden). The
+    largest keeps the plain resource names (ts_nine_json, ts_nine_nsw); the smaller
+    ones carry their size (ts_nine_h32_json). A size that wasn't exported into the
+    binary resolves to the next larger one that was, so a build with only the full
+    model still works, every size just sounds (and costs) the same.
+
+    Whether a size is an LSTM or a GRU is up to its export: the architecture is read
+    from the resource and ModelDispatch builds the network type compiled for it. An
+    export whose width doesn't match its name counts as missing.
+
+    All sizes are prepared up front, so switching between them on the audio thread
+    never allocates. Weights are still only loaded for the sizes actually used.
+*/
+template <int... hiddenSizes>
+class ModelFamily
+{
+public:
+    static constexpr int numSizes = (int) sizeof... (hiddenSizes);
+    using Dispatch = ModelDispatch<hiddenSizes...>;
+
+    explicit ModelFamily (const std::string& modelName)
+    {
+        for (int i = 0; i < numSizes; ++i)
+        {
+            auto& slot = slots[(size_t) i];
+            slot.binaryName = resourceName (modelName, i, "nsw");
+            slot.jsonName = resourceName (modelName, i, "json");
+
+            const auto architecture = ModelArchitecture::read (slot.binaryName.c_str(), slot.jsonName.c_str());
+            if (architecture.hiddenSize == getHiddenSize (i))
+                slot.model = Dispatch::create (architecture, slot.binaryName.c_str(), slot.jsonName.c_str());
+
+            //in the binary but not a shape this build was compiled for
+            jassert (slot.model != nullptr || ! architecture.isValid());
+        }
+    }
+
+    static int getHiddenSize (int index) noexcept
+    {
+        constexpr int table[] { hiddenSizes... };
+        return table[juce::jlimit (0, numSizes - 1, index)];
+    }
+
+    /** Architecture of a size's export, invalid if it isn't in the binary. */
+    ModelArchitecture getArchitecture (int index) const noexcept
+    {
+        auto* model = get (index);
+        return model != nullptr ? model->getArchitecture() : ModelArchitecture {};
+    }
+
+    /** The smallest size at or above requested that is in the binary. */
+    int resolve (int requested) const noexcept
+    {
+        for (int i = juce::jmax (0, requested); i < numSizes - 1; ++i)
+            if (get (i) != nullptr)
+                return i;
+
+        return numSizes - 1;
+    }
+
+    /** The largest size below index that is in the binary, or -1 if there isn't one. */
+    int nextSmaller (int index) const noexcept
+    {
+        for (int i = juce::jmin (index, numSizes) - 1; i >= 0; --i)
+            if (get (i) != nullptr)
+                return i;
+
+        return -1;
+    }
+
+    /** Loads a size's weights (and the reduced precision copy if needed) on the calling
+        thread. Never call from the audio thread.
+    */
+    void loadNow (int index, WeightPrecision precision)
+    {
+        if (auto* model = get (index))
+            model->loadNow (precision);
+    }
+
+    /** Asks the loader thread for a size's weights. Realtime safe. */
+    void requestLoad (int index, WeightPrecision precision) noexcept
+    {
+        if (auto* model = get (index))
+            model->requestLoad (precision);
+    }
+
+    /** preferred if its weights are loaded, otherwise the largest size that is loaded,
+        or -1 if none are yet.
+    */
+    int findLoaded (int preferred) const noexcept
+    {
+        if (auto* model = get (preferred); model != nullptr && model->isLoaded())
+            return preferred;
+
+        for (int i = numSizes - 1; i >= 0; --i)
+            if (auto* model = get (i); model != nullptr && model->isLoaded())
+                return i;
+
+        return -1;
+    }
+
+    /** Hands every size whatever weights have been published so far. Realtime safe. */
+    void updateWeights (WeightPrecision precision) noexcept
+    {
+        forEach ([&] (RecurrentModel& model) { model.updateWeights (precision); });
+    }
+
+    void setKernel (const LSTMKernel::Kernel& kernel)
+    {
+        forEach ([&] (RecurrentModel& model) { model.setKernel (kernel); });
+    }
+
+    /** See ActivationAccuracy. Realtime safe, and cheap when it doesn't change. */
+    void setActivationAccuracy (ActivationAccuracy accuracy) noexcept
+    {
+        forEach ([&] (RecurrentModel& model) { model.setActivationAccuracy (accuracy); });
+    }
+
+    /** Threads to spread each size's channels over, see NeuralModel::setWorkerPool().
+        Call before prepare(), not realtime safe.
+    */
+    void setWorkerPool (WorkerPool* pool) noexcept
+    {
+        forEach ([&] (RecurrentModel& model) { model.setWorkerPool (pool); });
+    }
+
+    /** Not realtime safe. */
+    void prepare (int numChannels, int maxBlockSize)
+    {
+        forEach ([&] (RecurrentModel& model) { model.prepare (numChannels, maxBlockSize); });
+    }
+
+    void setIdleDetection (float threshold, int holdSamples) noexcept
+    {
+        forEach ([&] (RecurrentModel& model) { model.setIdleDetection (threshold, holdSamples); });
+    }
+
+    /** Clears one size's hidden state. Realtime safe. */
+    void reset (int index) noexcept
+    {
+        if (auto* model = get (index))
+            model->reset();
+    }
+
+    /** Runs one size's network in place, see NeuralModel::process(). */
+    void process (int index, float* const* channels, int numChannels, const SubBlockRun* runs, int numRuns,
+                  OutputStage* output, bool parallel) noexcept
+    {
+        if (auto* model = get (index))
+            model->process (channels, numChannels, runs, numRuns, output, parallel);
+    }
+
+private:
+    struct Slot
+    {
+        std::string binaryName, jsonName; //the model keeps pointers to these
+        std::unique_ptr<RecurrentModel> model;
+    };
+
+    static std::string resourceName (const std::string& modelName, int index, const char* extension)
+    {
+        const auto isFullSize = index == numSizes - 1;
+        return modelName + (isFullSize ? "" : "_h" + std::to_string (getHiddenSize (index))) + "_" + extension;
+    }
+
+    RecurrentModel* get (int index) const noexcept
+    {
+        return juce::isPositiveAndBelow (index, numSizes) ? slots[(size_t) index].model.get() : nullptr;
+    }
+
+    template <typename Function>
+    void forEach (Function&& f)
+    {
+        for (auto& slot : slots)
+            if (slot.model != nullptr)
+                f (*slot.model);
+    }
+
+    std::array<Slot, numSizes> slots;
+
+    JUCE_DECLARE_NON_COPYABLE (ModelFamily)
+};
@@ -0,0 +1,139 @@
+/*
+  ==============================================================================
+
+    ModelLoader.h
+    On-demand model loading with lock-free publication to the audio thread
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "RTNeural.h"
+#include "WeightStore.h"
+
+
+/** Loads a model from its .nsw resource (see Python/export_binary.py), which is a
+    straight memcpy, and only parses the JSON export if that is missing or stale.
+*/
+template <typename Weights>
+bool loadModelWeights (Weights& weights, const char* binaryResource, const char* jsonResource)
+{
+    int size = 0;
+    if (auto* data = BinaryData::getNamedResource (binaryResource, size))
+        if (weights.loadBinary (data, (size_t) size))
+            return true;
+
+    if (auto* data = BinaryData::getNamedResource (jsonResource, size))
+        return weights.loadJson (nlohmann::json::parse (data, data + size));
+
+    return false;
+}
+
+
+//==============================================================================
+/** One low priority thread per process that every plugin instance's LazyWeights share. */
+struct ModelLoaderThread : public juce::TimeSliceThread
+{
+    ModelLoaderThread() : juce::TimeSliceThread ("Neural Screamer model loader")
+    {
+        startThread (juce::Thread::Priority::low);
+    }
+
+    ~ModelLoaderThread() override
+    {
+        stopThread (2000);
+    }
+};
+
+
+/**
+    A model's weights, loaded only when somebody asks for them.
+
+    Message-thread code (prepareToPlay, setStateInformation) can load synchronously
+    with loadNow(). The audio thread must never block, so it calls requestLoad(),
+    which only sets a flag; the shared ModelLoaderThread notices within a few ms,
+    loads the weights and publishes them with a release store. get() is a single
+    acquire load, so the audio thread picks them up on its next block without locks.
+
+    The weights themselves come from the WeightStore, so every instance that
+    uses the same model holds a reference to the same read-only copy.
+*/
+template <typename Weights>
+class LazyWeights : private juce::TimeSliceClient
+{
+public:
+    LazyWeights (const char* binaryResourceName, const char* jsonResourceName)
+    : binaryResource (binaryResourceName), jsonResource (jsonResourceName)
+    {
+        loaderThread->addTimeSliceClient (this);
+    }
+
+    ~LazyWeights() override
+    {
+        loaderThread->removeTimeSliceClient (this);
+    }
+
+    /** The weights, or nullptr if they haven't been loaded yet. Realtime safe. */
+    const Weights* get() const noexcept { return published.load (std::memory_order_acquire); }
+
+    bool isLoaded() const noexcept { return get() != nullptr; }
+
+    /** Asks the loader thread to load the weights. Realtime safe. */
+    void requestLoad() noexcept
+    {
+        if (! isLoaded())
+            loadRequested.store (true, std::memory_order_relaxed);
+    }
+
+    /** Loads the weights on the calling thread if needed. Never call from the audio thread. */
+    bool loadNow()
+    {
+        const std::lock_guard<std::mutex> lock (loadMutex);
+
+        if (! isLoaded())
+        {
+            auto weights = WeightStore::get<Weights> (binaryResource, [this] (Weights& w)
+            {
+                return loadModelWeights (w, binaryResource, jsonResource);
+            });
+
+            if (weights == nullptr)
+            {
+                jassertfalse; //resource missing or doesn't match the compiled model shape
+                loadRequested.store (false, std::memory_order_relaxed);
+                return false;
+            }
+
+            storage = std::move (weights);
+            published.store (storage.get(), std::memory_order_release);
+        }
+
+        loadRequested.store (false, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    int useTimeSlice() override
+    {
+        if (loadRequested.load (std::memory_order_relaxed))
+            loadNow();
+
+        return 20; //ms until we look again
+    }
+
+    const char* binaryResource;
+    const char* jsonResource;
+
+    juce::SharedResourcePointer<ModelLoaderThread> loaderThread;
+
+    std::mutex loadMutex;
+    std::shared_ptr<const Weights> storage;
+    std::atomic<const Weights*> published {nullptr};
+    std::atomic<bool> loadRequested {false};
+
+    JUCE_DECLARE_NON_COPYABLE (LazyWeights)
+};
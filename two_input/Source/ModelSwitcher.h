@@ -0,0 +1,231 @@
+/*
+  ==============================================================================
+
+    ModelSwitcher.h
+    Moves from one network to another without a click
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <vector>
+#include "OutputStage.h"
+#include "SubBlockParameters.h"
+
+
+/**
+    Runs whichever network of a ModelFamily is asked for, and when that changes
+    (TS9/Mini, QUALITY or the governor) gets there in three phases:
+
+        warming   the incoming network is reset and runs on a copy of the live input
+                  for warmSeconds, its output thrown away, while the outgoing one is
+                  still all that's heard
+        fading    both run, equal-power crossfade over fadeSeconds
+        idle      only the incoming one runs
+
+    Cutting straight over, or fading from the first sample the incoming network
+    runs, plays its hidden state settling from zero (or from wherever it was left
+    the last time it ran). After warming it already tracks the input, so the fade
+    only has to blend two outputs that are both correct.
+
+    The level and tone (OutputStage) are fused into the network when one runs on
+    its own; during a switch they run as a pass of their own over the mix. A network
+    running on its own gets the whole block at once, during a switch the runs go
+    through one at a time, since the phase can change between them.
+
+    Two networks only ever run during a switch. A switch asked for while warming
+    replaces the incoming network (or cancels if it's the one that is already
+    playing); one asked for while fading waits for the fade to finish, so the
+    output never jumps between partly faded mixes.
+
+    Everything but prepare() is realtime safe.
+*/
+template <typename Family>
+class ModelSwitcher
+{
+public:
+    static constexpr double warmSeconds = 0.05;
+    static constexpr double fadeSeconds = 0.03;
+
+    ModelSwitcher() = default;
+
+    /** sampleRate is the rate the networks run at. Not realtime safe. */
+    void prepare (double sampleRate, int numChannels, int maxBlockSize)
+    {
+        warmLength = juce::jmax (1, juce::roundToInt (warmSeconds * sampleRate));
+        fadeLength = juce::jmax (1, juce::roundToInt (fadeSeconds * sampleRate));
+        shadow.setSize (numChannels, maxBlockSize);
+        runChannels.resize ((size_t) numChannels);
+        reset();
+    }
+
+    /** Forgets what was running, so the next network starts without a switch. */
+    void reset() noexcept
+    {
+        current = incoming = {};
+        phase = Phase::idle;
+        position = 0;
+    }
+
+    bool isSwitching() const noexcept { return phase != Phase::idle; }
+
+    /** Runs the network at index in family in place over a block's runs, switching to
+        it first if it isn't the one that ran last, then output. index -1 (nothing
+        loaded yet) only runs output. parallel is passed on, see NeuralModel::process().
+    */
+    void process (Family* family, int index, float* const* channels, int numChannels, const SubBlockRun* runs,
+                  int numRuns, OutputStage& output, bool parallel) noexcept
+    {
+        request ({ family, index });
+
+        for (int r = 0; r < numRuns; ++r)
+        {
+            if (phase == Phase::idle && current.isValid())
+            {
+                current.process (channels, numChannels, runs + r, numRuns - r, &output, parallel);
+                return;
+            }
+
+            jassert (numChannels <= (int) runChannels.size());
+            for (int ch = 0; ch < numChannels; ++ch)
+                runChannels[(size_t) ch] = channels[ch] + runs[r].start;
+
+            auto run = runs[r];
+            run.start = 0; //the channels already start there
+
+            if (phase == Phase::idle)
+                output.process (runChannels.data(), run.output, 0, numChannels, run.length);
+            else
+                processSwitching (runChannels.data(), numChannels, run, output, parallel);
+        }
+    }
+
+private:
+    /** One run with both networks going, channels pointing at its first sample. */
+    void processSwitching (float* const* channels, int numChannels, const SubBlockRun& run,
+                           OutputStage& output, bool parallel) noexcept
+    {
+        const auto numSamples = run.length;
+        jassert (numChannels <= shadow.getNumChannels() && numSamples <= shadow.getNumSamples());
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            shadow.copyFrom (ch, 0, channels[ch], numSamples);
+
+        incoming.process (shadow.getArrayOfWritePointers(), numChannels, &run, 1, nullptr, parallel);
+        current.process (channels, numChannels, &run, 1, nullptr, parallel);
+
+        if (phase == Phase::warming)
+        {
+            position += numSamples;
+            if (position >= warmLength)
+                startPhase (Phase::fading);
+        }
+        else if (phase == Phase::fading)
+        {
+            fade (channels, numChannels, numSamples);
+
+            position += numSamples;
+            if (position >= fadeLength)
+            {
+                current = incoming;
+                startPhase (Phase::idle);
+            }
+        }
+
+        output.process (channels, run.output, 0, numChannels, numSamples);
+    }
+
+    struct Network
+    {
+        Family* family {nullptr};
+        int index {-1};
+
+        bool isValid() const noexcept { return family != nullptr && index >= 0; }
+        bool operator== (const Network& other) const noexcept { return family == other.family && index == other.index; }
+        bool operator!= (const Network& other) const noexcept { return ! operator== (other); }
+
+        void process (float* const* channels, int numChannels, const SubBlockRun* runs, int numRuns,
+                      OutputStage* output, bool parallel) const noexcept
+        {
+            if (isValid())
+                family->process (index, channels, numChannels, runs, numRuns, output, parallel);
+        }
+    };
+
+    enum class Phase { idle, warming, fading };
+
+    void request (Network wanted) noexcept
+    {
+        if (! wanted.isValid())
+        {
+            reset();
+            return;
+        }
+
+        //the first network since prepare() or reset() has nothing to fade from
+        if (! current.isValid())
+        {
+            current = wanted;
+            return;
+        }
+
+        switch (phase)
+        {
+            case Phase::idle:
+                if (wanted != current)
+                    startWarming (wanted);
+                break;
+
+            case Phase::warming:
+                if (wanted == current)
+                    startPhase (Phase::idle);
+                else if (wanted != incoming)
+                    startWarming (wanted);
+                break;
+
+            case Phase::fading: //the next switch starts once this one is done
+                break;
+        }
+    }
+
+    void startWarming (Network wanted) noexcept
+    {
+        incoming = wanted;
+        incoming.family->reset (incoming.index);
+        startPhase (Phase::warming);
+    }
+
+    void startPhase (Phase newPhase) noexcept
+    {
+        phase = newPhase;
+        position = 0;
+    }
+
+    /** cos/sin gains, so the summed power stays level for outputs that aren't in phase. */
+    void fade (float* const* channels, int numChannels, int numSamples) const noexcept
+    {
+        const auto step = juce::MathConstants<float>::halfPi / (float) fadeLength;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* in = shadow.getReadPointer (ch);
+            auto* out = channels[ch];
+
+            for (int n = 0; n < numSamples; ++n)
+            {
+                const auto angle = juce::jmin (juce::MathConstants<float>::halfPi, (float) (position + n) * step);
+                out[n] = std::cos (angle) * out[n] + std::sin (angle) * in[n];
+            }
+        }
+    }
+
+    Network current, incoming;
+    Phase phase {Phase::idle};
+    int warmLength {1}, fadeLength {1}, position {0};
+    juce::AudioBuffer<float> shadow;
+    std::vector<float*> runChannels;
+
+    JUCE_DECLARE_NON_COPYABLE (ModelSwitcher)
+};
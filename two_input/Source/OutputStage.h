@@ -0,0 +1,194 @@
+/*
+  ==============================================================================
+
+    OutputStage.h
+    Level and tone, applied to each network output sample as it's produced
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+/**
+    The VOLUME gain and the TONE low-pass (a TPT state variable filter, the same
+    one as juce::dsp::StateVariableTPTFilter with its default resonance), for
+    every channel.
+
+    BatchedRNN calls processLanes() from its Dense pass, so each output sample
+    goes through the gain and the filter while it is still in a register instead
+    of the whole block being streamed through memory again. The lanes of a batch
+    (the left and right channel for stereo) are independent, and each is updated
+    in turn by a plain scalar loop; with two lanes and a five-operation recursion
+    there isn't enough in one sample to fill a vector register. process() is the
+    same thing as a pass of its own, for outputs that don't come straight from
+    one network (a crossfade, an idle batch).
+
+    setCutoff() and setGain() describe the next run of samples; getSettings() takes
+    a copy of that, and the processing itself only reads the copy it's given. So a
+    block's runs can all be worked out first and then processed together, and
+    different channels can be processed on different threads.
+
+    It runs at the rate the networks run at. Everything but prepare() is realtime safe.
+*/
+class OutputStage
+{
+public:
+    /** Channels are handled in groups of this many in process(). */
+    static constexpr int lanesPerGroup = 2;
+
+    /** State is kept for channel counts rounded up to this, so padding lanes have somewhere to go. */
+    static constexpr int maxLanes = 8;
+
+    /** The gain ramp and the filter coefficients for one run of samples. */
+    struct Settings
+    {
+        float g {0.0f}, h {1.0f};
+        float gain {1.0f}, step {0.0f};
+    };
+
+    /** The filter state of numLanes neighbouring channels, copied out for a run with
+        load() and written back once at its end with store(), so channels processed on
+        different threads don't fight over the cache line they share.
+    */
+    template <int numLanes>
+    struct LaneState
+    {
+        float s1[numLanes] {}, s2[numLanes] {};
+    };
+
+    void prepare (double newSampleRate, int numChannels)
+    {
+        sampleRate = newSampleRate;
+        const auto numStates = (size_t) ((numChannels + maxLanes - 1) / maxLanes * maxLanes);
+        s1.assign (numStates, 0.0f);
+        s2.assign (numStates, 0.0f);
+
+        cutoff = 0.0f;
+        setCutoff (1000.0f);
+    }
+
+    void reset() noexcept
+    {
+        std::fill (s1.begin(), s1.end(), 0.0f);
+        std::fill (s2.begin(), s2.end(), 0.0f);
+    }
+
+    /** Recomputes the coefficients (a tan()), only if frequency changed. */
+    void setCutoff (float frequency) noexcept
+    {
+        frequency = juce::jlimit (1.0f, (float) (0.49 * sampleRate), frequency);
+        if (frequency == cutoff)
+            return;
+
+        cutoff = frequency;
+        const auto g = (float) std::tan (juce::MathConstants<double>::pi * cutoff / sampleRate);
+        settings.g = g;
+        settings.h = 1.0f / (1.0f + resonanceTerm * g + g * g);
+    }
+
+    float getCutoff() const noexcept { return cutoff; }
+
+    /** The gain for the next run of samples: gainAtStart for its first, then moving by
+        gainStep per sample.
+    */
+    void setGain (float gainAtStart, float gainStep) noexcept
+    {
+        settings.gain = gainAtStart;
+        settings.step = gainStep;
+    }
+
+    /** The cutoff and gain set last, for a run processed with them later. */
+    const Settings& getSettings() const noexcept { return settings; }
+
+    /** The state of channels firstChannel to firstChannel + numLanes - 1. */
+    template <int numLanes>
+    LaneState<numLanes> load (int firstChannel) const noexcept
+    {
+        jassert (firstChannel + numLanes <= (int) s1.size());
+        LaneState<numLanes> state;
+        std::copy_n (s1.data() + firstChannel, numLanes, state.s1);
+        std::copy_n (s2.data() + firstChannel, numLanes, state.s2);
+        return state;
+    }
+
+    template <int numLanes>
+    void store (const LaneState<numLanes>& state, int firstChannel) noexcept
+    {
+        jassert (firstChannel + numLanes <= (int) s1.size());
+        std::copy_n (state.s1, numLanes, s1.data() + firstChannel);
+        std::copy_n (state.s2, numLanes, s2.data() + firstChannel);
+    }
+
+    /** Gain then low-pass, in place, for sample n of a run with the given settings on
+        the channels state was loaded from.
+    */
+    template <int numLanes>
+    static void processLanes (float (&samples)[numLanes], LaneState<numLanes>& state, const Settings& run, int n) noexcept
+    {
+        tick (samples, state.s1, state.s2, run, n);
+    }
+
+    /** processLanes() over a whole run, as a pass of its own. */
+    void process (float* const* channels, const Settings& run, int firstChannel, int numChannels, int numSamples) noexcept
+    {
+        for (int first = 0; first < numChannels; first += lanesPerGroup)
+        {
+            if (numChannels - first >= lanesPerGroup)
+                processRun<lanesPerGroup> (channels + first, run, firstChannel + first, numSamples);
+            else
+                processRun<1> (channels + first, run, firstChannel + first, numSamples);
+        }
+    }
+
+private:
+    static constexpr float resonanceTerm = 1.41421356f; //1 / resonance, with resonance 1 / sqrt (2)
+
+    template <int numLanes>
+    void processRun (float* const* channels, const Settings& run, int firstChannel, int numSamples) noexcept
+    {
+        auto state = load<numLanes> (firstChannel);
+
+        for (int n = 0; n < numSamples; ++n)
+        {
+            float lanes[numLanes];
+            for (int l = 0; l < numLanes; ++l)
+                lanes[l] = channels[l][n];
+
+            processLanes (lanes, state, run, n);
+
+            for (int l = 0; l < numLanes; ++l)
+                channels[l][n] = lanes[l];
+        }
+
+        store (state, firstChannel);
+    }
+
+    template <int numLanes>
+    static void tick (float (&samples)[numLanes], float (&state1)[numLanes], float (&state2)[numLanes],
+                      const Settings& run, int n) noexcept
+    {
+        const auto g = run.g, h = run.h;
+        const auto sampleGain = run.gain + run.step * (float) n;
+
+        for (int l = 0; l < numLanes; ++l)
+        {
+            const auto x = samples[l] * sampleGain;
+            const auto highpass = h * (x - state1[l] * (g + resonanceTerm) - state2[l]);
+            const auto bandpass = highpass * g + state1[l];
+            state1[l] = highpass * g + bandpass;
+            const auto lowpass = bandpass * g + state2[l];
+            state2[l] = bandpass * g + lowpass;
+            samples[l] = lowpass;
+        }
+    }
+
+    double sampleRate {44100.0};
+    float cutoff {0.0f};
+    Settings settings;
+    std::vector<float> s1, s2;
+};
@@ -0,0 +1,164 @@
+/*
+  ==============================================================================
+
+    PerformanceMonitor.h
+    Per-instance processBlock timing, published lock-free off the audio thread
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+
+
+/**
+    Times every processBlock against its deadline (numSamples / sampleRate) and
+    splits the time between the networks (with the level and tone fused into
+    them) and everything around them: the resampling to and from their rate,
+    parameter smoothing and picking the model. The network time is what's spent
+    between beginNetwork() and endNetwork(), which may bracket several runs in
+    one block.
+
+    The audio thread only reads the tick counter and updates plain members, so it
+    never allocates or locks. Every publishInterval seconds of audio it pushes a
+    Snapshot into a small AbstractFifo; if nobody is draining it (a headless host
+    that never polls) snapshots are just dropped, which is harmless because the
+    counters in them are cumulative.
+
+    Consumer side: getSnapshot() from one non-audio thread at a time, e.g. the
+    editor's timer or a host's polling loop.
+*/
+class PerformanceMonitor
+{
+public:
+    /** 10% wide bins of block time over deadline; the last one is every block that missed it. */
+    static constexpr int numLoadBins = 11;
+
+    struct Snapshot
+    {
+        juce::int64 numBlocks   {0};
+        juce::int64 numOverruns {0};   //blocks that took longer than their deadline
+        std::array<juce::int64, numLoadBins> loadHistogram {};
+
+        float recentLoad     {0.0f};   //average time / deadline over the last interval
+        float recentPeakLoad {0.0f};   //worst block of the last interval
+        float worstLoad      {0.0f};   //worst block since prepare()
+
+        double networkSeconds {0.0};   //total time in the networks
+        double otherSeconds   {0.0};   //total time in the rest of processBlock
+
+        /** Fraction of the DSP time spent in the network. */
+        float networkShare() const noexcept
+        {
+            const auto total = networkSeconds + otherSeconds;
+            return total > 0.0 ? (float) (networkSeconds / total) : 0.0f;
+        }
+    };
+
+    /** Clears everything. Call before playback starts, not from the audio thread. */
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        publishEverySamples = juce::jmax (1, (int) (sampleRate * publishInterval));
+
+        current = {};
+        latest = {};
+        lastLoad = 0.0f;
+        intervalTime = intervalDeadline = 0.0;
+        intervalSamples = 0;
+        fifo.reset();
+    }
+
+    //==============================================================================
+    /** Audio thread: beginBlock(), then any number of beginNetwork() / endNetwork()
+        pairs, then endBlock().
+    */
+    void beginBlock (int numSamples) noexcept
+    {
+        blockSamples = numSamples;
+        networkTicks = 0;
+        blockStart = juce::Time::getHighResolutionTicks();
+    }
+
+    void beginNetwork() noexcept
+    {
+        networkStart = juce::Time::getHighResolutionTicks();
+    }
+
+    void endNetwork() noexcept
+    {
+        networkTicks += juce::Time::getHighResolutionTicks() - networkStart;
+    }
+
+    void endBlock() noexcept
+    {
+        if (sampleRate <= 0.0 || blockSamples <= 0)
+            return;
+
+        const auto end = juce::Time::getHighResolutionTicks();
+        const auto total   = juce::Time::highResolutionTicksToSeconds (end - blockStart);
+        const auto network = juce::Time::highResolutionTicksToSeconds (networkTicks);
+        const auto deadline = blockSamples / sampleRate;
+        const auto load = (float) (total / deadline);
+        const auto overrun = load > 1.0f;
+        lastLoad = load;
+
+        ++current.numBlocks;
+        current.numOverruns += overrun ? 1 : 0;
+        ++current.loadHistogram[(size_t) (overrun ? numLoadBins - 1 : juce::jmin (numLoadBins - 2, (int) (load * 10.0f)))];
+        current.worstLoad = juce::jmax (current.worstLoad, load);
+        current.recentPeakLoad = juce::jmax (current.recentPeakLoad, load);
+        current.networkSeconds += network;
+        current.otherSeconds   += total - network;
+
+        intervalTime += total;
+        intervalDeadline += deadline;
+        intervalSamples += blockSamples;
+
+        if (intervalSamples >= publishEverySamples)
+        {
+            current.recentLoad = (float) (intervalTime / intervalDeadline);
+            fifo.write (1).forEach ([this] (int index) { slots[(size_t) index] = current; });
+
+            current.recentPeakLoad = 0.0f;
+            intervalTime = intervalDeadline = 0.0;
+            intervalSamples = 0;
+        }
+    }
+
+    /** Time over deadline of the block endBlock() just finished. Audio thread only. */
+    float getLastLoad() const noexcept { return lastLoad; }
+
+    //==============================================================================
+    /** The most recent snapshot the audio thread published. Not for the audio thread. */
+    Snapshot getSnapshot() noexcept
+    {
+        const auto ready = fifo.getNumReady();
+        if (ready > 0)
+            fifo.read (ready).forEach ([this] (int index) { latest = slots[(size_t) index]; });
+
+        return latest;
+    }
+
+private:
+    static constexpr double publishInterval = 0.05; //seconds of audio between snapshots
+    static constexpr int fifoSize = 8;
+
+    double sampleRate {0.0};
+    int publishEverySamples {1};
+
+    //audio thread only
+    juce::int64 blockStart {0}, networkStart {0}, networkTicks {0};
+    int blockSamples {0};
+    float lastLoad {0.0f};
+    Snapshot current;
+    double intervalTime {0.0}, intervalDeadline {0.0};
+    int intervalSamples {0};
+
+    juce::AbstractFifo fifo {fifoSize};
+    std::array<Snapshot, fifoSize> slots;
+
+    //consumer only
+    Snapshot latest;
+};
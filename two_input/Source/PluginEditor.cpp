@@ -11,7 +11,7 @@
 
 //==============================================================================
 Two_inputAudioProcessorEditor::Two_inputAudioProcessorEditor (Two_inputAudioProcessor& p)
-: AudioProcessorEditor (&p), audioProcessor (p), driveLabel("DRIVE"), volLabel("LEVEL"), toneLabel("TONE"), buttonLabel("MODEL"), title("NEURAL SCREAMER")
+: AudioProcessorEditor (&p), audioProcessor (p), driveLabel("DRIVE"), volLabel("LEVEL"), toneLabel("TONE"), buttonLabel("MODEL"), title("NEURAL SCREAMER"), performanceOverlay(p.getPerformanceMonitor(), p.getActiveKernelName())
 {
     setSize (800, 400);
     juce::LookAndFeel::setDefaultLookAndFeel(&myCustomLNF);
@@ -45,6 +45,9 @@ Two_inputAudioProcessorEditor::Two_inputAudioProcessorEditor (Two_inputAudioProc
     //title
     addAndMakeVisible(title);
     
+    //CPU readout along the bottom edge
+    addAndMakeVisible(performanceOverlay);
+    
     //to make the plugin resizable --> kinda wonky on Reaper?
     setResizable(true, true);
     getConstrainer()->setFixedAspectRatio(getWidth()/getHeight());
@@ -123,6 +126,10 @@ void Two_inputAudioProcessorEditor::resized()
                     juce::Colours::white);
     title.setFont(juce::FontOptions(fontSize*1.1));
     
+    
+    //CPU readout, under the big border
+    performanceOverlay.setBounds(getWidth()*0.3, getHeight()*0.93, getWidth()*0.68, getHeight()*0.05);
+    
 }
 
 
@@ -61,5 +61,7 @@ private:
     
     CustomLabel title;
     
+    PerformanceOverlay performanceOverlay;
+    
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Two_inputAudioProcessorEditor)
 };
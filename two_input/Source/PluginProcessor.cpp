@@ -7,7 +7,9 @@
 */
 
 #include "PluginProcessor.h"
-#include "PluginEditor.h"
+#if ! NEURALSCREAMER_HEADLESS
+ #include "PluginEditor.h"
+#endif
 
 //==============================================================================
 Two_inputAudioProcessor::Two_inputAudioProcessor()
@@ -22,20 +24,12 @@ Two_inputAudioProcessor::Two_inputAudioProcessor()
                        ), apvts(*this, nullptr, "Parameters", createParams())
 
 #endif
+    , kernel (&LSTMKernel::select())
 {
-    //Load model 1
-    juce::MemoryInputStream jsonStream1 (BinaryData::ts_nine_json, BinaryData::ts_nine_jsonSize, false);
-    auto jsonInput1 = nlohmann::json::parse (jsonStream1.readEntireStreamAsString().toStdString());
-    neuralNet9[0].parseJson (jsonInput1);
-    neuralNet9[1].parseJson (jsonInput1);
-    
+    setKernel (*kernel);
 
-    //Load model 2
-    juce::MemoryInputStream jsonStream2 (BinaryData::ts_mini_json, BinaryData::ts_mini_jsonSize, false);
-    auto jsonInput2 = nlohmann::json::parse (jsonStream2.readEntireStreamAsString().toStdString());
-    neuralNetMini[0].parseJson (jsonInput2);
-    neuralNetMini[1].parseJson (jsonInput2);
-    
+    //Models aren't loaded here: the host hasn't restored our state yet, so we don't
+    //know which one will be used. See loadSelectedModel().
 }
 
 Two_inputAudioProcessor::~Two_inputAudioProcessor()
@@ -45,7 +39,11 @@ Two_inputAudioProcessor::~Two_inputAudioProcessor()
 //==============================================================================
 const juce::String Two_inputAudioProcessor::getName() const
 {
+   #ifdef JucePlugin_Name
     return JucePlugin_Name;
+   #else
+    return "Neural Screamer";
+   #endif
 }
 
 bool Two_inputAudioProcessor::acceptsMidi() const
@@ -77,7 +75,8 @@ bool Two_inputAudioProcessor::isMidiEffect() const
 
 double Two_inputAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    //the network rings on after the input stops, at most until idle detection has seen it settle
+    return juce::jmax (0.0, idleHoldSeconds);
 }
 
 int Two_inputAudioProcessor::getNumPrograms()
@@ -107,21 +106,54 @@ void Two_inputAudioProcessor::changeProgramName (int index, const juce::String&
 //==============================================================================
 void Two_inputAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-//Reset neural networks
-    neuralNet9[0].reset();
-    neuralNet9[1].reset();
-    neuralNetMini[0].reset();
-    neuralNetMini[1].reset();
+//Make sure the selected model is ready before the first block
+    loadSelectedModel();
+    neuralNet9.updateWeights (precision);
+    neuralNetMini.updateWeights (precision);
+    neuralNet9.setActivationAccuracy (activations);
+    neuralNetMini.setActivationAccuracy (activations);
+
+//The networks only sound right at the rate they were trained at, so they run at
+//modelSampleRate behind a resampler whenever the host is at another rate
+    const auto numChannels = juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+    resampling.prepare (sampleRate, modelSampleRate, getResamplingQuality(), numChannels, samplesPerBlock);
+    setLatencySamples (resampling.getLatencySamples());
+
+//Spread the channels over helper threads if asked to
+    if (workerThreads <= 0)
+        workerPool.reset();
+    else if (workerPool == nullptr || workerPool->getNumWorkers() != workerThreads)
+        workerPool = std::make_unique<WorkerPool> (workerThreads);
+    neuralNet9.setWorkerPool (workerPool.get());
+    neuralNetMini.setWorkerPool (workerPool.get());
+
+//Size and reset neural networks for however many channels the host gives us
+    const auto netBlockSize = resampling.getMaxInnerBlockSize();
+    neuralNet9.prepare (numChannels, netBlockSize);
+    neuralNetMini.prepare (numChannels, netBlockSize);
+
+//Stop running the networks on channels that have gone quiet
+    const auto idleThreshold = juce::Decibels::decibelsToGain (idleThresholdDb);
+    const auto idleHoldSamples = juce::jmax (0, juce::roundToInt (idleHoldSeconds * resampling.getInnerRate()));
+    neuralNet9.setIdleDetection (idleThreshold, idleHoldSamples);
+    neuralNetMini.setIdleDetection (idleThreshold, idleHoldSamples);
+
+//Switch between networks at the rate they run at
+    switcher.prepare (resampling.getInnerRate(), numChannels, netBlockSize);
+
+//Start the knobs where they are, without a ramp
+    setParameterTargets();
+    smoothedDrive.prepare (resampling.getInnerRate(), parameterRampSeconds, smoothedDrive.getTarget());
+    smoothedVolume.prepare (resampling.getInnerRate(), parameterRampSeconds, smoothedVolume.getTarget());
+    smoothedTone.prepare (resampling.getInnerRate(), parameterRampSeconds, smoothedTone.getTarget());
+    networkBlocks.prepare (subBlockSize);
+    networkRuns.resize ((size_t) (netBlockSize / subBlockSize + 2)); //a block can start and end mid sub-block
     
-//Reset Lowpass Filter
-    juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = getMainBusNumInputChannels();
+//Reset the level and Lowpass Filter, they run with the networks
+    outputStage.prepare (resampling.getInnerRate(), numChannels);
 
-    filter.reset();
-    filter.prepare(spec);
-    filter.setType(filtertype);
+    performance.prepare (sampleRate);
+    governor.prepare (sampleRate);
 }
 
 
@@ -156,55 +188,96 @@ bool Two_inputAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 
 void Two_inputAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-    static double worstMs = 0;
-    const auto t0 = juce::Time::getHighResolutionTicks();
+    performance.beginBlock (buffer.getNumSamples());
     
     
     juce::ScopedNoDenormals noDenormals;
     
  
-    //Read drive knob
-    auto d {apvts.getRawParameterValue("DRIVE")};
-    auto drive = d->load();
-    
-    //Read volume knob
-    auto v {apvts.getRawParameterValue("VOLUME")};
-    auto volume = v->load();
-    
-    //Get tone knob and set cutoff freq
-    auto c = apvts.getRawParameterValue("TONE")->load();
-    filter.setCutoffFrequency(c);
+    //Read the drive, volume and tone knobs, they glide there over the next sub-blocks
+    setParameterTargets();
     
     //Check to see which button is on and update model if changes
     auto ts {apvts.getRawParameterValue("TS9")};
     auto TS9_b = ts->load();
     
-    //see which network is being used
-    auto& nets = TS9_b ? neuralNet9 : neuralNetMini;
+    //see which network and size are being used. If they haven't been loaded yet the loader
+    //thread is asked for them and we keep playing whatever is loaded until they're published
+    auto& wanted = TS9_b ? neuralNet9 : neuralNetMini;
+    auto& other = TS9_b ? neuralNetMini : neuralNet9;
+    const auto weightPrecision = precision.load (std::memory_order_relaxed);
+    const auto adaptive = adaptiveQuality.load (std::memory_order_relaxed) && ! isNonRealtime();
+    if (! adaptive)
+        governor.reset();
+
+    const auto selected = getSelectedSize (wanted);
+    const auto size = getGovernedSize (wanted, selected);
+    wanted.requestLoad (size, weightPrecision);
+
+    //keep the next size down loaded so the governor can step to it straight away
+    const auto smaller = wanted.nextSmaller (size);
+    if (adaptive && smaller >= 0)
+        wanted.requestLoad (smaller, weightPrecision);
+
+    neuralNet9.updateWeights (weightPrecision);
+    neuralNetMini.updateWeights (weightPrecision);
+
+    const auto activationAccuracy = getGovernedActivations();
+    neuralNet9.setActivationAccuracy (activationAccuracy);
+    neuralNetMini.setActivationAccuracy (activationAccuracy);
+
+    auto* family = &wanted;
+    auto index = wanted.findLoaded (size);
+    if (index < 0)
+    {
+        family = &other;
+        index = other.findLoaded (getSelectedSize (other));
+    }
    
-    //process samples
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    //process samples at the model's rate, every channel advances in the same step
+    const auto numChannels = buffer.getNumChannels();
+    resampling.process (buffer.getArrayOfWritePointers(), numChannels, buffer.getNumSamples(),
+                        [&] (float* const* channels, int numSamples)
     {
-        auto* x = buffer.getWritePointer (ch);
-        for (int n = 0; n < buffer.getNumSamples(); ++n)
+        performance.beginNetwork();
+
+        //the knobs for every sub-block first, so the networks can have the whole block at once
+        auto numRuns = 0;
+        networkBlocks.process (numSamples, [&] (int start, int length, bool isNewSubBlock)
         {
-            float input[] = { x[n], drive }; //needs to be a pointer to a float (i.e. a single array?)
-            auto y = nets[ch].forward(input);
-            x[n] = y * (volume * 0.9);
-        }
-    }
+            //the lowpass coefficients only change at a sub-block boundary
+            if (isNewSubBlock)
+            {
+                smoothedDrive.advance (subBlockSize);
+                smoothedVolume.advance (subBlockSize);
+                smoothedTone.advance (subBlockSize);
+                outputStage.setCutoff (smoothedTone.getValue());
+            }
+
+            //volume and lowpass filtering happen as each network output sample comes out
+            outputStage.setGain (smoothedVolume.getRampValue (networkBlocks.getPosition(), subBlockSize),
+                                 smoothedVolume.getRampStep (subBlockSize));
+
+            jassert (numRuns < (int) networkRuns.size());
+            networkRuns[(size_t) numRuns++] = { start, length, smoothedDrive.getValue(), outputStage.getSettings() };
+        });
+
+        //one channel layout and one hand-off to the helper threads for the whole block
+        const auto parallel = numSamples >= minParallelSamples;
+        switcher.process (family, index, channels, numChannels, networkRuns.data(), numRuns, outputStage, parallel);
+
+        performance.endNetwork();
+    });
     
 
-    const auto t1 = juce::Time::getHighResolutionTicks();
-    const auto ms = juce::Time::highResolutionTicksToSeconds(t1 - t0) * 1000.0;
-    if (ms > worstMs) { worstMs = ms; DBG("processBlock ms worst=" << worstMs); }
-    
-    
-    //lowpass filtering
-    auto block = juce::dsp::AudioBlock<float> {buffer};
-    auto context = juce::dsp::ProcessContextReplacing<float>(block);
-    filter.process(context);
-    
+    performance.endBlock();
+
+    //too close to the deadline, or plenty of room again: change size from the next block
+    const auto canStepDown = smaller >= 0 || (activationAccuracy != ActivationAccuracy::fast);
+    if (adaptive && governor.update (performance.getLastLoad(), buffer.getNumSamples(), canStepDown))
+        governor.logTransition (Family::getHiddenSize (size), activationAccuracy == ActivationAccuracy::fast,
+                                Family::getHiddenSize (getGovernedSize (wanted, selected)),
+                                getGovernedActivations() == ActivationAccuracy::fast);
 }
 
 
@@ -213,12 +286,20 @@ void Two_inputAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, ju
 //==============================================================================
 bool Two_inputAudioProcessor::hasEditor() const
 {
+   #if NEURALSCREAMER_HEADLESS
+    return false; //offline render builds don't link the editor
+   #else
     return true; // (change this to false if you choose to not supply an editor)
+   #endif
 }
 
 juce::AudioProcessorEditor* Two_inputAudioProcessor::createEditor()
 {
+   #if NEURALSCREAMER_HEADLESS
+    return nullptr;
+   #else
     return new Two_inputAudioProcessorEditor (*this);
+   #endif
 }
 
 //==============================================================================
@@ -235,6 +316,13 @@ void Two_inputAudioProcessor::setStateInformation (const void* data, int sizeInB
         if (xmlState.get() != nullptr)
             if (xmlState->hasTagName (apvts.state.getType()))
                 apvts.replaceState (juce::ValueTree::fromXml (*xmlState));
+
+        precision = (WeightPrecision) (int) apvts.state.getProperty ("precision", (int) WeightPrecision::full);
+        adaptiveQuality = (bool) apvts.state.getProperty ("adaptive", false);
+        activations = (ActivationAccuracy) (int) apvts.state.getProperty ("activations", (int) ActivationAccuracy::exact);
+
+        //Now we know which model the session uses
+        loadSelectedModel();
 }
 
 //==============================================================================
@@ -253,6 +341,14 @@ juce::AudioProcessorValueTreeState::ParameterLayout Two_inputAudioProcessor::cre
     params.push_back(std::make_unique<juce::AudioParameterFloat> (juce::ParameterID("TONE", 3), "tone", juce::NormalisableRange<float>(20.0f, 20000.0f, 1.0f, 0.4f), 20000.0f));
     params.push_back(std::make_unique<juce::AudioParameterBool> (juce::ParameterID("TS9", 4), "ts9", true));
     params.push_back(std::make_unique<juce::AudioParameterBool> (juce::ParameterID("MINI", 5), "mini", false));
+
+    //Network size: smaller ones trade some fidelity for a lot less CPU
+    juce::StringArray qualities {"eco", "low", "medium", "high", "full"};
+    static_assert (Family::numSizes == 5, "one name per size");
+    for (int i = 0; i < qualities.size(); ++i)
+        qualities.getReference (i) << " (" << Family::getHiddenSize (i) << ")";
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice> (juce::ParameterID("QUALITY", 6), "quality", qualities, Family::numSizes - 1));
     return {params.begin(), params.end()};
 }
 
@@ -261,7 +357,113 @@ juce::AudioProcessorValueTreeState::ParameterLayout Two_inputAudioProcessor::cre
 
 void Two_inputAudioProcessor::reset()
 {
-    filter.reset();
+    outputStage.reset();
+    resampling.reset();
+    switcher.reset();
+
+    smoothedDrive.snapTo (smoothedDrive.getTarget());
+    smoothedVolume.snapTo (smoothedVolume.getTarget());
+    smoothedTone.snapTo (smoothedTone.getTarget());
+    networkBlocks.reset();
+}
+
+
+void Two_inputAudioProcessor::setParameterTargets()
+{
+    smoothedDrive.setTarget (apvts.getRawParameterValue ("DRIVE")->load());
+    smoothedVolume.setTarget (apvts.getRawParameterValue ("VOLUME")->load() * 0.9f);
+    smoothedTone.setTarget (apvts.getRawParameterValue ("TONE")->load());
 }
 
 
+void Two_inputAudioProcessor::setKernel (const LSTMKernel::Kernel& newKernel)
+{
+    kernel = &newKernel;
+    neuralNet9.setKernel (newKernel);
+    neuralNetMini.setKernel (newKernel);
+}
+
+
+void Two_inputAudioProcessor::setIdleDetection (float thresholdDb, double holdSeconds)
+{
+    idleThresholdDb = thresholdDb;
+    idleHoldSeconds = holdSeconds;
+}
+
+
+void Two_inputAudioProcessor::setResamplingQuality (FixedRateStage::Quality quality)
+{
+    //kept on the state tree rather than as a parameter: changing it changes our latency
+    apvts.state.setProperty ("resampling", (int) quality, nullptr);
+}
+
+
+FixedRateStage::Quality Two_inputAudioProcessor::getResamplingQuality() const
+{
+    return (FixedRateStage::Quality) (int) apvts.state.getProperty ("resampling", (int) FixedRateStage::Quality::normal);
+}
+
+
+void Two_inputAudioProcessor::setWeightPrecision (WeightPrecision newPrecision)
+{
+    apvts.state.setProperty ("precision", (int) newPrecision, nullptr);
+    precision = newPrecision;
+}
+
+
+void Two_inputAudioProcessor::setActivationAccuracy (ActivationAccuracy newAccuracy)
+{
+    apvts.state.setProperty ("activations", (int) newAccuracy, nullptr);
+    activations = newAccuracy;
+}
+
+
+void Two_inputAudioProcessor::setAdaptiveQuality (bool shouldAdapt)
+{
+    apvts.state.setProperty ("adaptive", shouldAdapt, nullptr);
+    adaptiveQuality = shouldAdapt;
+}
+
+
+void Two_inputAudioProcessor::setWorkerThreads (int numThreads)
+{
+    workerThreads = juce::jmax (0, numThreads);
+}
+
+
+void Two_inputAudioProcessor::loadSelectedModel()
+{
+    //Message thread only: loads synchronously, the other model is left to the
+    //loader thread if and when it gets selected
+    const bool TS9_b = apvts.getRawParameterValue ("TS9")->load() > 0.5f;
+    auto& family = TS9_b ? neuralNet9 : neuralNetMini;
+    family.loadNow (getSelectedSize (family), precision);
+}
+
+
+int Two_inputAudioProcessor::getSelectedSize (const Family& family) const
+{
+    //Realtime safe: the QUALITY choice, moved up to a size this build has weights for
+    return family.resolve ((int) apvts.getRawParameterValue ("QUALITY")->load());
+}
+
+
+int Two_inputAudioProcessor::getGovernedSize (const Family& family, int selected) const noexcept
+{
+    //selected, stepped down as many of the sizes in the binary as the governor asks for
+    //after its first step, which is to the fast activations unless they're selected anyway
+    const auto activationSteps = activations.load (std::memory_order_relaxed) != ActivationAccuracy::fast ? 1 : 0;
+
+    auto size = selected;
+    for (int i = activationSteps; i < governor.getReduction() && family.nextSmaller (size) >= 0; ++i)
+        size = family.nextSmaller (size);
+
+    return size;
+}
+
+
+ActivationAccuracy Two_inputAudioProcessor::getGovernedActivations() const noexcept
+{
+    //any step down at all runs the fast activations, the cheapest reduction there is
+    return governor.getReduction() > 0 ? ActivationAccuracy::fast : activations.load (std::memory_order_relaxed);
+}
@@ -9,9 +9,21 @@
 #pragma once
 
 #define RTNEURAL_USE_XSIMD 1
-#define RTNEURAL_DEFAULT_ALIGNMENT 16
+#if defined (__AVX__)
+ #define RTNEURAL_DEFAULT_ALIGNMENT 32
+#else
+ #define RTNEURAL_DEFAULT_ALIGNMENT 16
+#endif
 #include <JuceHeader.h>
 #include "RTNeural.h"
+#include "BatchedLSTM.h"
+#include "ModelLoader.h"
+#include "ModelFamily.h"
+#include "ModelSwitcher.h"
+#include "PerformanceMonitor.h"
+#include "QualityGovernor.h"
+#include "Resampler.h"
+#include "SubBlockParameters.h"
 #include <juce_dsp/juce_dsp.h>
 #include <iostream>
 #include <fstream>
@@ -64,6 +76,60 @@ public:
 //    bool supportsDoublePrecisionProcessing() const override { return false; }
     
 
+    /** Name of the recurrent kernel picked for this CPU, e.g. "avx2". */
+    juce::String getActiveKernelName() const { return kernel->name; }
+
+    /** Forces a kernel from LSTMKernel::getAvailable(), e.g. to compare them. Call before prepareToPlay. */
+    void setKernel (const LSTMKernel::Kernel& newKernel);
+
+    /** Channels whose input stays below thresholdDb for holdSeconds stop running the
+        network until signal returns (see NeuralModel). holdSeconds <= 0 turns this off.
+        Takes effect at the next prepareToPlay.
+    */
+    void setIdleDetection (float thresholdDb, double holdSeconds);
+
+    /** Rate the models were trained at (see Python/preprocessing.py). */
+    static constexpr double modelSampleRate = 44100.0;
+
+    /** How the networks are resampled to modelSampleRate at other host rates; off runs
+        them at the host rate. Saved with the session, takes effect at the next prepareToPlay.
+    */
+    void setResamplingQuality (FixedRateStage::Quality quality);
+    FixedRateStage::Quality getResamplingQuality() const;
+
+    /** Storage the networks read their weights from, see WeightPrecision. Can be changed
+        while playing: the reduced precision copies are loaded in the background the first
+        time they're needed, and the fp32 weights are used until then. Saved with the session.
+    */
+    void setWeightPrecision (WeightPrecision newPrecision);
+    WeightPrecision getWeightPrecision() const noexcept { return precision.load(); }
+
+    /** How the networks evaluate their sigmoids and tanhs, see ActivationAccuracy. exact
+        (the default) matches the trained model; accurate and fast trade a little of that
+        for speed. Can be changed while playing. Saved with the session.
+    */
+    void setActivationAccuracy (ActivationAccuracy newAccuracy);
+    ActivationAccuracy getActivationAccuracy() const noexcept { return activations.load(); }
+
+    /** Lets the network get cheaper while the audio thread is short of headroom, and come
+        back once it recovers (see QualityGovernor): first the fast activations, then sizes
+        below the QUALITY one. Off by default, since only the 64 unit models ship so far,
+        and never active while rendering offline. Saved with the session.
+    */
+    void setAdaptiveQuality (bool shouldAdapt);
+    bool getAdaptiveQuality() const noexcept { return adaptiveQuality.load(); }
+
+    /** Runs the channels of a block on numThreads helper threads as well as the audio
+        thread (see WorkerPool), when the block is long enough to be worth handing over.
+        0, the default, keeps everything on the audio thread. Not saved with the session,
+        it depends on the machine. Takes effect at the next prepareToPlay.
+    */
+    void setWorkerThreads (int numThreads);
+    int getWorkerThreads() const noexcept { return workerThreads; }
+
+    /** Block timing for this instance. Poll getSnapshot() from one non-audio thread. */
+    PerformanceMonitor& getPerformanceMonitor() noexcept { return performance; }
+
 // APVTS to hold params
     juce::AudioProcessorValueTreeState apvts;
     juce::AudioProcessorValueTreeState::ParameterLayout createParams();
@@ -72,23 +138,71 @@ private:
     //==============================================================================
 
     
+    //SIMD kernel picked by CPUID at construction
+    const LSTMKernel::Kernel* kernel;
+
+    //Each model at every hidden size the QUALITY parameter offers. Weights are shared
+    //by every channel of a model, and only loaded once a model and size are actually
+    //selected, so a session that never switches never loads the others
+    using Family = ModelFamily<16, 24, 32, 48, 64>;
+    void loadSelectedModel();
+    int getSelectedSize (const Family& family) const;
+
+    //Storage the weights are read from, see setWeightPrecision()
+    std::atomic<WeightPrecision> precision {WeightPrecision::full};
+
+    //How the cells evaluate their activations, see setActivationAccuracy()
+    std::atomic<ActivationAccuracy> activations {ActivationAccuracy::exact};
+
+    //Makes the network cheaper while processBlock runs close to its deadline, see setAdaptiveQuality()
+    QualityGovernor governor;
+    std::atomic<bool> adaptiveQuality {false};
+    int getGovernedSize (const Family& family, int selected) const noexcept;
+    ActivationAccuracy getGovernedActivations() const noexcept;
+
     //TS9 model
-    RTNeural::ModelT<float, 2, 1,
-                    RTNeural::LSTMLayerT<float, 2, 64>,
-                    RTNeural::DenseT<float, 64, 1>
-                    > neuralNet9[2];
+    Family neuralNet9 {"ts_nine"};
     
     //Mini model
-    RTNeural::ModelT<float, 2, 1,
-                    RTNeural::LSTMLayerT<float, 2, 64>,
-                    RTNeural::DenseT<float, 64, 1>
-                    > neuralNetMini[2];
+    Family neuralNetMini {"ts_mini"};
     
     
-    //Low Pass Filter
-    juce::dsp::StateVariableTPTFilter<float> filter;
-    juce::dsp::StateVariableTPTFilterType filtertype {juce::dsp::StateVariableTPTFilterType::lowpass};
+    //Helper threads for the channels, see setWorkerThreads(). Blocks shorter than
+    //minParallelSamples (at the networks' rate) stay on the audio thread: a channel on
+    //its own costs about 0.6 of a pair, so the hand-off and the wait for the slowest
+    //thread need a few hundred samples to pay back (see the worker_pool benchmark)
+    static constexpr int minParallelSamples = 256;
+    int workerThreads {0};
+    std::unique_ptr<WorkerPool> workerPool;
+
+    //Volume and Low Pass Filter, fused into the networks' output layer
+    OutputStage outputStage;
     void reset() override;
+
+    //Runs the networks at modelSampleRate whatever the host rate is
+    FixedRateStage resampling;
+
+    //Whenever the network that runs changes (TS9/Mini, QUALITY or the governor) the new
+    //one is warmed up on the live input before it's crossfaded in
+    ModelSwitcher<Family> switcher;
+
+    //DRIVE, VOLUME and TONE glide over parameterRampSeconds in sub-blocks of subBlockSize
+    //samples at the networks' rate: the drive and cutoff are only recomputed at each
+    //boundary, the volume is ramped per sample
+    static constexpr int subBlockSize = 32;
+    static constexpr double parameterRampSeconds = 0.05;
+    SubBlockParameter<> smoothedDrive, smoothedVolume;
+    SubBlockParameter<juce::ValueSmoothingTypes::Multiplicative> smoothedTone;
+    SubBlockSplitter networkBlocks;
+    std::vector<SubBlockRun> networkRuns;
+    void setParameterTargets();
+
+    //Idle detection, see setIdleDetection()
+    float idleThresholdDb {-80.0f};
+    double idleHoldSeconds {0.2};
+
+    //processBlock timing, see getPerformanceMonitor()
+    PerformanceMonitor performance;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Two_inputAudioProcessor)
 };
@@ -0,0 +1,187 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+    Makes the network cheaper when the audio thread runs short of headroom
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+#include "ModelLoader.h"
+
+
+/**
+    Watches each block's time over deadline (see PerformanceMonitor::getLastLoad())
+    and decides how many steps cheaper than selected the network should run. What a
+    step is is up to the processor: the fast activations first, then each smaller
+    size.
+
+    The load is smoothed over smoothingSeconds. When it stays above stepDownLoad
+    for stepDownSeconds, or a block misses its deadline outright, the reduction goes
+    up by one; after a step it waits settleSeconds so the cheaper size gets measured
+    before it steps again. Once the load has stayed below stepUpLoad for stepUpSeconds
+    the reduction goes back down by one. Each size costs roughly 1.5x the one below,
+    so stepUpLoad is low enough that stepping up shouldn't land straight back above
+    stepDownLoad; if it does anyway (the host's own load changed), the wait before
+    the next step up doubles, up to maxStepUpSeconds.
+
+    Everything but the log is audio thread only. Transitions go through a small
+    AbstractFifo and are written to juce::Logger from the shared ModelLoaderThread.
+*/
+class QualityGovernor : private juce::TimeSliceClient
+{
+public:
+    QualityGovernor()  { loggerThread->addTimeSliceClient (this); }
+    ~QualityGovernor() override { loggerThread->removeTimeSliceClient (this); }
+
+    /** Starts again at the selected size. Not realtime safe. */
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        reduction = 0;
+        smoothedLoad = 0.0f;
+        highSamples = lowSamples = 0;
+        settleSamples = seconds (settleSeconds); //the first blocks run on cold caches
+        sinceStepUpSamples = -1;
+        stepUpWait = stepUpSeconds;
+        elapsedSamples = 0;
+    }
+
+    /** How many steps cheaper than selected to run. */
+    int getReduction() const noexcept { return reduction; }
+
+    /** Call once per block after PerformanceMonitor::endBlock(). canStepDown is whether
+        there is a cheaper step than the one that just ran. Returns true if the reduction
+        changed, in which case call logTransition() once the new network is known.
+    */
+    bool update (float blockLoad, int numSamples, bool canStepDown) noexcept
+    {
+        if (sampleRate <= 0.0 || numSamples <= 0)
+            return false;
+
+        const auto alpha = 1.0f - (float) std::exp (-numSamples / (smoothingSeconds * sampleRate));
+        smoothedLoad += alpha * (blockLoad - smoothedLoad);
+        elapsedSamples += numSamples;
+        lastOverrun = blockLoad > 1.0f;
+
+        if (sinceStepUpSamples >= 0)
+            sinceStepUpSamples += numSamples;
+
+        if (settleSamples > 0)
+        {
+            settleSamples -= numSamples;
+            return false;
+        }
+
+        highSamples = smoothedLoad > stepDownLoad ? highSamples + numSamples : 0;
+        lowSamples  = smoothedLoad < stepUpLoad   ? lowSamples + numSamples  : 0;
+
+        if (canStepDown && (lastOverrun || highSamples >= seconds (stepDownSeconds)))
+        {
+            //back straight down soon after stepping up: wait longer next time
+            if (sinceStepUpSamples >= 0 && sinceStepUpSamples < seconds (stepUpWait))
+                stepUpWait = juce::jmin (maxStepUpSeconds, stepUpWait * 2.0);
+
+            return step (+1);
+        }
+
+        if (reduction > 0 && lowSamples >= seconds (stepUpWait))
+        {
+            sinceStepUpSamples = 0;
+            return step (-1);
+        }
+
+        return false;
+    }
+
+    /** Queues a line for the log about the step update() just took, from and to a hidden
+        size and whether it runs the fast activations. Realtime safe.
+    */
+    void logTransition (int fromHiddenSize, bool fromFast, int toHiddenSize, bool toFast) noexcept
+    {
+        fifo.write (1).forEach ([&] (int index)
+        {
+            slots[(size_t) index] = { elapsedSamples / sampleRate, fromHiddenSize, toHiddenSize, fromFast, toFast,
+                                      lastStepDown, smoothedLoad, lastOverrun };
+        });
+    }
+
+private:
+    struct Transition
+    {
+        double time;                      //seconds of audio since prepare()
+        int fromHiddenSize, toHiddenSize;
+        bool fromFast, toFast;            //fast activations
+        bool down;
+        float load;                       //smoothed load when it stepped
+        bool overrun;                     //the last block missed its deadline
+    };
+
+    bool step (int direction) noexcept
+    {
+        reduction = juce::jmax (0, reduction + direction);
+        lastStepDown = direction > 0;
+        highSamples = lowSamples = 0;
+        settleSamples = seconds (settleSeconds);
+        return true;
+    }
+
+    juce::int64 seconds (double s) const noexcept { return (juce::int64) (s * sampleRate); }
+
+    int useTimeSlice() override
+    {
+        const auto ready = fifo.getNumReady();
+        if (ready > 0)
+            fifo.read (ready).forEach ([this] (int index)
+            {
+                const auto& t = slots[(size_t) index];
+                auto describe = [] (int hiddenSize, bool fast)
+                {
+                    return juce::String (hiddenSize) + " units" + (fast ? " with fast activations" : "");
+                };
+
+                juce::Logger::writeToLog ("Neural Screamer: " + juce::String (t.down ? "low headroom" : "headroom back")
+                                          + ", network " + describe (t.fromHiddenSize, t.fromFast) + " -> " + describe (t.toHiddenSize, t.toFast)
+                                          + " at " + juce::String (t.time, 2) + " s (load " + juce::String (juce::roundToInt (t.load * 100.0f)) + "%"
+                                          + (t.overrun ? ", missed deadline)" : ")"));
+            });
+
+        return 100; //ms until we look again
+    }
+
+    static constexpr float  stepDownLoad     = 0.8f;  //smoothed time / deadline
+    static constexpr float  stepUpLoad       = 0.45f;
+    static constexpr double smoothingSeconds = 0.05;
+    static constexpr double stepDownSeconds  = 0.1;
+    static constexpr double settleSeconds    = 0.25;
+    static constexpr double stepUpSeconds    = 2.0;
+    static constexpr double maxStepUpSeconds = 30.0;
+    static constexpr int fifoSize = 16;
+
+    double sampleRate {0.0};
+
+    //audio thread only
+    int reduction {0};
+    float smoothedLoad {0.0f};
+    bool lastOverrun {false}, lastStepDown {false};
+    juce::int64 highSamples {0}, lowSamples {0}, settleSamples {0};
+    juce::int64 sinceStepUpSamples {-1};  //-1 until the first step up
+    double stepUpWait {stepUpSeconds};
+    juce::int64 elapsedSamples {0};
+
+    juce::AbstractFifo fifo {fifoSize};
+    std::array<Transition, fifoSize> slots {};
+
+    juce::SharedResourcePointer<ModelLoaderThread> loggerThread;
+
+    JUCE_DECLARE_NON_COPYABLE (QualityGovernor)
+};
@@ -0,0 +1,337 @@
+/*
+  ==============================================================================
+
+    Resampler.h
+    Polyphase resampling so the networks always run at the rate they were trained at
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+
+/**
+    Streaming windowed-sinc resampler for one fixed rational ratio (outputRate / inputRate
+    = upFactor / downFactor), e.g. 147/160 for 48k -> 44.1k.
+
+    Each output sample is one dot product of numTaps input samples with one of upFactor
+    precomputed phases of the filter, so the cost per output sample is fixed by
+    zeroCrossings and doesn't depend on the ratio. The cutoff sits just below the lower
+    of the two Nyquist frequencies.
+*/
+class PolyphaseResampler
+{
+public:
+    /** Not realtime safe. maxInputBlock is the most samples a single process() call gets. */
+    void prepare (double inputRate, double outputRate, int zeroCrossings, int numChannels, int maxInputBlock)
+    {
+        const auto in = juce::roundToInt (inputRate);
+        const auto out = juce::roundToInt (outputRate);
+        const auto divisor = std::gcd (in, out);
+        upFactor = out / divisor;
+        downFactor = in / divisor;
+
+        //cutoff in cycles per input sample, and the filter's half length for zeroCrossings of it
+        const auto cutoff = 0.5 * passband * std::min (1.0, (double) out / in);
+        halfTaps = juce::jmax (1, (int) std::ceil (zeroCrossings / (2.0 * cutoff)));
+        numTaps = 2 * halfTaps;
+
+        table.assign ((size_t) (upFactor * numTaps), 0.0f);
+        for (int phase = 0; phase < upFactor; ++phase)
+        {
+            auto* coeffs = table.data() + phase * numTaps;
+            double sum = 0.0;
+
+            for (int j = 0; j < numTaps; ++j)
+            {
+                //distance from the output instant to input tap j, in input samples
+                const auto t = (double) phase / upFactor + (halfTaps - 1) - j;
+                const auto x = 2.0 * cutoff * t;
+                const auto sinc = x == 0.0 ? 1.0 : std::sin (juce::MathConstants<double>::pi * x) / (juce::MathConstants<double>::pi * x);
+                const auto w = blackman (t / halfTaps);
+
+                coeffs[j] = (float) (2.0 * cutoff * sinc * w);
+                sum += coeffs[j];
+            }
+
+            //unity gain at DC for every phase, so there's no ripple on offsets
+            for (int j = 0; j < numTaps; ++j)
+                coeffs[j] = (float) (coeffs[j] / sum);
+        }
+
+        maxInput = juce::jmax (1, maxInputBlock);
+        history.resize ((size_t) numChannels);
+        for (auto& h : history)
+            h.assign ((size_t) (numTaps + maxInput), 0.0f);
+
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& h : history)
+            std::fill (h.begin(), h.end(), 0.0f);
+
+        //halfTaps - 1 samples of silence in front so the first output is centred on input 0
+        filled = halfTaps - 1;
+        position = (juce::int64) (halfTaps - 1) * upFactor;
+    }
+
+    /** Most output samples a process() call with numInput samples can produce. */
+    int getMaxOutput (int numInput) const noexcept
+    {
+        return (int) (((juce::int64) (numInput + numTaps) * upFactor) / downFactor) + 2;
+    }
+
+    /** How far behind its input the output runs, in input samples. */
+    int getLatency() const noexcept { return halfTaps; }
+
+    /** Takes numInput samples per channel and writes every output sample they complete,
+        which getMaxOutput (numInput) bounds. Returns how many that was. More than
+        maxInputBlock samples are taken in pieces of that.
+    */
+    int process (const float* const* input, int numInput, float* const* output, int numChannels) noexcept
+    {
+        jassert (numChannels <= maxChannels && numChannels <= (int) history.size());
+
+        int produced = 0;
+        for (int start = 0; start < numInput; start += maxInput)
+        {
+            const float* in[maxChannels];
+            float* out[maxChannels];
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                in[ch] = input[ch] + start;
+                out[ch] = output[ch] + produced;
+            }
+
+            produced += processPiece (in, juce::jmin (maxInput, numInput - start), out, numChannels);
+        }
+
+        return produced;
+    }
+
+private:
+    static constexpr int maxChannels = 8;
+
+    int processPiece (const float* const* input, int numInput, float* const* output, int numChannels) noexcept
+    {
+        jassert (filled + numInput <= (int) history[0].size());
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            std::copy (input[ch], input[ch] + numInput, history[(size_t) ch].data() + filled);
+
+        filled += numInput;
+        int produced = 0;
+
+        //an output at input time t needs inputs floor(t) - halfTaps + 1 ... floor(t) + halfTaps
+        while ((int) (position / upFactor) + halfTaps < filled)
+        {
+            const auto first = (int) (position / upFactor) - (halfTaps - 1);
+            const auto* coeffs = table.data() + (int) (position % upFactor) * numTaps;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto* x = history[(size_t) ch].data() + first;
+                float acc = 0.0f;
+
+                for (int j = 0; j < numTaps; ++j)
+                    acc += x[j] * coeffs[j];
+
+                output[ch][produced] = acc;
+            }
+
+            ++produced;
+            position += downFactor;
+        }
+
+        //drop inputs no future output will reach
+        const auto consumed = juce::jlimit (0, filled, (int) (position / upFactor) - (halfTaps - 1));
+        for (auto& h : history)
+            std::memmove (h.data(), h.data() + consumed, (size_t) (filled - consumed) * sizeof (float));
+
+        filled -= consumed;
+        position -= (juce::int64) consumed * upFactor;
+        return produced;
+    }
+
+    static double blackman (double x) noexcept //x in [-1, 1]
+    {
+        const auto a = juce::MathConstants<double>::pi * (x + 1.0);
+        return 0.42 - 0.5 * std::cos (a) + 0.08 * std::cos (2.0 * a);
+    }
+
+    static constexpr double passband = 0.9; //cutoff as a fraction of the lower Nyquist
+
+    int upFactor {1}, downFactor {1};
+    int halfTaps {1}, numTaps {2};
+    int maxInput {1};
+    std::vector<float> table;                //[phase][tap]
+
+    std::vector<std::vector<float>> history; //[channel][sample]
+    int filled {0};                          //valid samples in history
+    juce::int64 position {0};                //next output instant, in 1/upFactor input samples
+};
+
+
+//==============================================================================
+/**
+    Runs a processing callback at a fixed inner sample rate inside a host running at
+    any rate: the block is resampled down to innerRate, handed to the callback, and
+    resampled back up.
+
+    The up and down resamplers don't produce an exact number of samples per block,
+    so the output goes through a small FIFO primed with silence, which keeps it from
+    running dry. getLatencySamples() is the whole delay in host samples, ready for
+    setLatencySamples().
+
+    When the host already runs at the inner rate, or quality is off, the stage
+    isn't active and the callback just gets the host buffer.
+*/
+class FixedRateStage
+{
+public:
+    /** Filter length for each setting; more zero crossings cost more and alias less. */
+    enum class Quality { off, draft, normal, high };
+
+    static int getZeroCrossings (Quality quality) noexcept
+    {
+        switch (quality)
+        {
+            case Quality::draft:  return 8;
+            case Quality::normal: return 16;
+            case Quality::high:   return 32;
+            case Quality::off:    break;
+        }
+
+        return 0;
+    }
+
+    /** Not realtime safe. */
+    void prepare (double hostRate, double newInnerRate, Quality quality, int numChannels, int maxBlockSize)
+    {
+        active = quality != Quality::off && juce::roundToInt (hostRate) != juce::roundToInt (newInnerRate);
+        innerRate = active ? newInnerRate : hostRate;
+        maxHostBlock = juce::jmax (1, maxBlockSize);
+        maxInnerBlock = maxHostBlock;
+        latency = 0;
+
+        if (! active)
+            return;
+
+        const auto zeroCrossings = getZeroCrossings (quality);
+        down.prepare (hostRate, innerRate, zeroCrossings, numChannels, maxBlockSize);
+        maxInnerBlock = down.getMaxOutput (maxBlockSize);
+        up.prepare (innerRate, hostRate, zeroCrossings, numChannels, maxInnerBlock);
+
+        inner.setSize (numChannels, maxInnerBlock);
+
+        //Both resamplers centre their first output on their first input, so the chain
+        //itself has no delay, but it holds back its lookahead (halfTaps of each filter)
+        //until later input arrives. Priming the FIFO with that much silence, plus up to
+        //one inner sample of rounding, keeps it from running dry and makes the whole
+        //stage a clean delay of exactly primeSamples.
+        primeSamples = (int) std::ceil (down.getLatency() + (up.getLatency() + 1) * hostRate / innerRate) + 2;
+        fifo.setSize (numChannels, primeSamples + up.getMaxOutput (maxInnerBlock) + maxBlockSize);
+
+        latency = primeSamples;
+        reset();
+    }
+
+    void reset()
+    {
+        if (! active)
+            return;
+
+        down.reset();
+        up.reset();
+        fifo.clear();
+        fifoCount = primeSamples;
+    }
+
+    bool isActive() const noexcept { return active; }
+
+    /** Rate the callback runs at. */
+    double getInnerRate() const noexcept { return innerRate; }
+
+    /** Most samples the callback is handed in one go. */
+    int getMaxInnerBlockSize() const noexcept { return maxInnerBlock; }
+
+    int getLatencySamples() const noexcept { return latency; }
+
+    /** Calls process (float* const* channels, int numSamples) at the inner rate, in place.
+        Blocks longer than prepare()'s maxBlockSize, which hosts are allowed to send, are
+        run in pieces of that, so the callback never gets more than getMaxInnerBlockSize().
+    */
+    template <typename ProcessFunction>
+    void process (float* const* channels, int numChannels, int numSamples, ProcessFunction&& processInner)
+    {
+        if (numSamples <= maxHostBlock)
+        {
+            processPiece (channels, numChannels, numSamples, processInner);
+            return;
+        }
+
+        jassert (numChannels <= maxChannels);
+        float* piece[maxChannels];
+
+        for (int start = 0; start < numSamples; start += maxHostBlock)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                piece[ch] = channels[ch] + start;
+
+            processPiece (piece, numChannels, juce::jmin (maxHostBlock, numSamples - start), processInner);
+        }
+    }
+
+private:
+    static constexpr int maxChannels = 8;
+
+    template <typename ProcessFunction>
+    void processPiece (float* const* channels, int numChannels, int numSamples, ProcessFunction& processInner)
+    {
+        if (! active)
+        {
+            processInner (channels, numSamples);
+            return;
+        }
+
+        jassert (numChannels <= maxChannels);
+        const auto numInner = down.process (channels, numSamples, inner.getArrayOfWritePointers(), numChannels);
+        processInner (inner.getArrayOfWritePointers(), numInner);
+
+        float* fifoEnd[maxChannels];
+        for (int ch = 0; ch < numChannels; ++ch)
+            fifoEnd[ch] = fifo.getWritePointer (ch, fifoCount);
+
+        fifoCount += up.process (inner.getArrayOfReadPointers(), numInner, fifoEnd, numChannels);
+
+        //hand the oldest numSamples back to the host
+        const auto available = juce::jmin (numSamples, fifoCount);
+        jassert (available == numSamples); //primeSamples too small, the FIFO ran dry
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* f = fifo.getWritePointer (ch);
+            std::copy (f, f + available, channels[ch]);
+            std::fill (channels[ch] + available, channels[ch] + numSamples, 0.0f);
+            std::memmove (f, f + available, (size_t) (fifoCount - available) * sizeof (float));
+        }
+
+        fifoCount -= available;
+    }
+
+    bool active {false};
+    double innerRate {0.0};
+    int maxHostBlock {1}, maxInnerBlock {0}, latency {0};
+
+    PolyphaseResampler down, up;
+    juce::AudioBuffer<float> inner, fifo;
+    int primeSamples {0}, fifoCount {0};
+};
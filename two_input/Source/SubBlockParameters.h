@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    SubBlockParameters.h
+    Smoothed knobs, applied in fixed sub-blocks whatever size the host's blocks are
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "OutputStage.h"
+
+
+/**
+    Cuts a stream of samples into sub-blocks of a fixed size. The boundaries are
+    counted from prepare() (or reset()), not from the start of each block, so
+    they land on the same samples whether the host sends 32 or 2048 at a time.
+*/
+class SubBlockSplitter
+{
+public:
+    void prepare (int newSubBlockSize) noexcept
+    {
+        subBlockSize = juce::jmax (1, newSubBlockSize);
+        reset();
+    }
+
+    void reset() noexcept { position = 0; }
+
+    int getSubBlockSize() const noexcept { return subBlockSize; }
+
+    /** Where the next sample falls within its sub-block. */
+    int getPosition() const noexcept { return position; }
+
+    /** Calls f (start, length, isNewSubBlock) for consecutive runs of numSamples that
+        never cross a boundary. isNewSubBlock is true for a run that begins one, which
+        is where derived state should be recomputed.
+    */
+    template <typename Function>
+    void process (int numSamples, Function&& f)
+    {
+        for (int start = 0; start < numSamples;)
+        {
+            const auto length = juce::jmin (numSamples - start, subBlockSize - position);
+            f (start, length, position == 0);
+
+            start += length;
+            position = (position + length) % subBlockSize;
+        }
+    }
+
+private:
+    int subBlockSize {32};
+    int position {0};
+};
+
+
+/** One run from SubBlockSplitter::process() and what holds for it: the drive folded
+    into the networks' gate bias and the level and tone their output goes through.
+    A block's runs are worked out before any of them is processed, so the networks
+    can be handed the whole block at once (see NeuralModel::process()).
+*/
+struct SubBlockRun
+{
+    int start {0}, length {0};
+    float drive {0.0f};
+    OutputStage::Settings output;
+};
+
+
+//==============================================================================
+/**
+    A parameter that glides to each new value over rampSeconds, in steps of one
+    sub-block. At every boundary advance() fixes where this sub-block starts and
+    ends, so values that are expensive to apply (filter coefficients, the drive
+    folded into the gate bias) change once per sub-block, while cheap ones like a
+    gain can still be ramped per sample with getRampValue().
+
+    SmoothingType is juce::ValueSmoothingTypes::Linear, or Multiplicative for
+    values heard on a log scale like a cutoff frequency.
+*/
+template <typename SmoothingType = juce::ValueSmoothingTypes::Linear>
+class SubBlockParameter
+{
+public:
+    /** sampleRate is the rate of the samples it's applied to. */
+    void prepare (double sampleRate, double rampSeconds, float value) noexcept
+    {
+        smoothed.reset (sampleRate, rampSeconds);
+        snapTo (value);
+    }
+
+    /** Jumps to value without a ramp. */
+    void snapTo (float value) noexcept
+    {
+        smoothed.setCurrentAndTargetValue (value);
+        start = end = value;
+    }
+
+    /** Reached over rampSeconds from the next sub-block on. */
+    void setTarget (float value) noexcept { smoothed.setTargetValue (value); }
+
+    float getTarget() const noexcept { return smoothed.getTargetValue(); }
+
+    /** Call at each sub-block boundary. */
+    void advance (int subBlockSize) noexcept
+    {
+        start = smoothed.getCurrentValue();
+        end = smoothed.isSmoothing() ? smoothed.skip (subBlockSize) : start;
+    }
+
+    /** The value held for the whole of the current sub-block. */
+    float getValue() const noexcept { return start; }
+
+    /** Whether the value changes during the current sub-block. */
+    bool isRamping() const noexcept { return start != end; }
+
+    /** How much getRampValue() moves per sample in the current sub-block. */
+    float getRampStep (int subBlockSize) const noexcept { return (end - start) / (float) subBlockSize; }
+
+    /** Linear from the start of the current sub-block to the start of the next. */
+    float getRampValue (int position, int subBlockSize) const noexcept
+    {
+        return start + (end - start) * (float) position / (float) subBlockSize;
+    }
+
+private:
+    juce::SmoothedValue<float, SmoothingType> smoothed;
+    float start {0.0f}, end {0.0f};
+};
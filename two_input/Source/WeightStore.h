@@ -0,0 +1,64 @@
+/*
+  ==============================================================================
+
+    WeightStore.h
+    Process-wide, reference counted cache of read-only model weights
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+
+
+/**
+    Every plugin instance asks the store for its weights instead of loading its own
+    copy, so 40 instances of the same model share one cache-resident set of weights.
+    Entries are held weakly: the weights are freed when the last instance lets go,
+    and reloaded if a model is asked for again later.
+
+    Lookups take a lock and may load, so they belong on the message or loader
+    thread, never the audio thread.
+*/
+class WeightStore
+{
+public:
+    /** Returns the shared weights for this resource, loading them with load(Weights&)
+        if nobody holds them right now. Returns nullptr if loading fails.
+    */
+    template <typename Weights, typename LoadFunction>
+    static std::shared_ptr<const Weights> get (const std::string& resourceName, LoadFunction&& load)
+    {
+        auto& store = getInstance();
+        const std::lock_guard<std::mutex> lock (store.mutex);
+
+        //the weights' type is part of the key, so differently shaped builds of one resource can't collide
+        const auto key = resourceName + "/" + typeid (Weights).name();
+        auto& entry = store.entries[key];
+
+        if (auto existing = entry.lock())
+            return std::static_pointer_cast<const Weights> (existing);
+
+        auto weights = std::make_shared<Weights>();
+        if (! load (*weights))
+            return nullptr;
+
+        entry = weights;
+        return weights;
+    }
+
+private:
+    static WeightStore& getInstance()
+    {
+        static WeightStore store;
+        return store;
+    }
+
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<const void>> entries;
+};
@@ -0,0 +1,199 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+    A few pinned threads that help the audio thread through one block
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+/**
+    Splits numTasks equal pieces of work (the channels of a network) between the
+    calling thread and numWorkers helper threads, and returns once all of them
+    are done.
+
+    Each worker has a mailbox of its own that only the caller writes, and only
+    between jobs, so handing out a job is a few plain stores and one atomic
+    increment per worker taking part: nothing is allocated and no lock is taken.
+    Task i goes to the caller if i % (numWorkers + 1) is 0 and to worker
+    i % (numWorkers + 1) - 1 otherwise.
+
+    Between jobs a worker spins for spinSeconds, so while audio is running it
+    picks the next job up within a fraction of a microsecond. After that it
+    parks on a WaitableEvent, and the first job after a pause has to signal it.
+    That's the only time the audio thread makes a system call here.
+
+    Workers run at realtime priority and are pinned to a core each, starting
+    from the second so the first is left to the host. One audio thread at a time
+    may call run(); constructing and destroying isn't realtime safe.
+*/
+class WorkerPool
+{
+public:
+    static constexpr double spinSeconds = 0.002;
+
+    explicit WorkerPool (int numWorkers)
+    {
+        const auto numCores = juce::jmax (1, juce::SystemStats::getNumCpus());
+
+        for (int w = 0; w < numWorkers; ++w)
+            workers.push_back (std::make_unique<Worker> (w, (w + 1) % numCores));
+
+        for (auto& worker : workers)
+            worker->startRealtimeThread (juce::Thread::RealtimeOptions{});
+    }
+
+    ~WorkerPool()
+    {
+        for (auto& worker : workers)
+        {
+            worker->signalThreadShouldExit();
+            worker->wake();
+        }
+
+        for (auto& worker : workers)
+            worker->stopThread (1000);
+    }
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    /** Calls task (i) for every i in [0, numTasks), on this thread and the workers,
+        and returns once every call has. task must be safe to call concurrently for
+        different i. Realtime safe.
+    */
+    template <typename Function>
+    void run (int numTasks, Function& task) noexcept
+    {
+        const auto stride = getNumWorkers() + 1;
+        const auto numActive = juce::jmin (getNumWorkers(), numTasks - 1);
+
+        for (int w = 0; w < numActive; ++w)
+            workers[(size_t) w]->post ({ &invoke<Function>, &task, w + 1, stride, numTasks });
+
+        for (int i = 0; i < numTasks; i += stride)
+            task (i);
+
+        for (int w = 0; w < numActive; ++w)
+            workers[(size_t) w]->waitUntilDone();
+    }
+
+private:
+    struct Job
+    {
+        void (*call) (void* task, int index) noexcept;
+        void* task;
+        int first, stride, end;
+    };
+
+    template <typename Function>
+    static void invoke (void* task, int index) noexcept { (*static_cast<Function*> (task)) (index); }
+
+    //==============================================================================
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker (int index, int core)
+            : juce::Thread ("NeuralScreamer worker " + juce::String (index + 1)),
+              affinity ((juce::uint32) 1 << (core % 32))
+        {
+        }
+
+        /** Caller side: hands over a job, only once the last one is done. */
+        void post (const Job& newJob) noexcept
+        {
+            job = newJob;
+            posted.fetch_add (1, std::memory_order_seq_cst);
+
+            if (parked.load (std::memory_order_seq_cst))
+                wakeUp.signal();
+        }
+
+        void waitUntilDone() const noexcept
+        {
+            const auto target = posted.load (std::memory_order_relaxed);
+
+            while (done.load (std::memory_order_acquire) != target)
+                pause();
+        }
+
+        void wake() { wakeUp.signal(); }
+
+        void run() override
+        {
+            setCurrentThreadAffinityMask (affinity);
+            juce::uint32 seen = 0; //not posted's value now, a job may already be waiting
+
+            while (! threadShouldExit())
+            {
+                if (! waitForJob (seen))
+                    continue;
+
+                seen = posted.load (std::memory_order_acquire);
+
+                for (int i = job.first; i < job.end; i += job.stride)
+                    job.call (job.task, i);
+
+                done.store (seen, std::memory_order_release);
+            }
+        }
+
+    private:
+        /** Spins, then parks. True once a job newer than seen has been posted. */
+        bool waitForJob (juce::uint32 seen)
+        {
+            const auto spinUntil = juce::Time::getMillisecondCounterHiRes() + spinSeconds * 1000.0;
+
+            while (posted.load (std::memory_order_acquire) == seen)
+            {
+                if (threadShouldExit())
+                    return false;
+
+                if (juce::Time::getMillisecondCounterHiRes() < spinUntil)
+                {
+                    for (int i = 0; i < 64; ++i)
+                        pause();
+
+                    continue;
+                }
+
+                //announce the park before checking again, so post() can't miss it
+                parked.store (true, std::memory_order_seq_cst);
+                if (posted.load (std::memory_order_seq_cst) == seen && ! threadShouldExit())
+                    wakeUp.wait (-1);
+                parked.store (false, std::memory_order_relaxed);
+            }
+
+            return true;
+        }
+
+        static void pause() noexcept
+        {
+           #if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+            __builtin_ia32_pause();
+           #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+            asm volatile ("yield");
+           #else
+            std::this_thread::yield();
+           #endif
+        }
+
+        const juce::uint32 affinity;
+        Job job {};
+        alignas (64) std::atomic<juce::uint32> posted {0};
+        alignas (64) std::atomic<juce::uint32> done {0};
+        std::atomic<bool> parked {false};
+        juce::WaitableEvent wakeUp;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    JUCE_DECLARE_NON_COPYABLE (WorkerPool)
+};